@@ -0,0 +1,583 @@
+/*
+ * the frame encoders & the ID generators of zigfrid: write_header() & 
+ * write_id() of each protocol write the frames of em_bits[], inc_em_id() 
+ * steps the IDs of em_ranges[] & em_dict[]. no registers, ports or interrupts
+ * in here, zigfrid.c includes it after its globals & so does tools/native.c 
+ * on the host, to check & time them off the chip.
+ *
+ * the includer defines, besides the tables & the config of frames.h:
+ *
+ *   em_bits[], em_frame_id[][5]        the ring of frames & their IDs
+ *   em_id_list[], read_range,          the current ID of each range, the
+ *   read_offset_id, dict_offset        one in use & the next one of em_dict[]
+ *   write_offset, write_mask           where write_bit() writes
+ *   profile                            whose 'encoding' EM41xx frames are in
+ *   read_byte(offset)                  byte 'offset' of the ID to write
+ */
+
+#if PROTOCOL == PROTOCOL_EM41XX
+/* the 4 data bits & even parity of each nibble as a row in em_bits[] format, 
+ * msb first & left aligned in the byte */
+#define ROW_MASK                0xF8
+#define DATA_MASK               0xF0
+const uint8_t em_rows[16] PROGMEM = {
+                        0xF8,   /* 0 = 0000 0 */
+                        0xE0,   /* 1 = 0001 1 */
+                        0xD0,   /* 2 = 0010 1 */
+                        0xC8,   /* 3 = 0011 0 */
+                        0xB0,   /* 4 = 0100 1 */
+                        0xA8,   /* 5 = 0101 0 */
+                        0x98,   /* 6 = 0110 0 */
+                        0x80,   /* 7 = 0111 1 */
+                        0x70,   /* 8 = 1000 1 */
+                        0x68,   /* 9 = 1001 0 */
+                        0x58,   /* A = 1010 0 */
+                        0x40,   /* B = 1011 1 */
+                        0x38,   /* C = 1100 0 */
+                        0x20,   /* D = 1101 1 */
+                        0x10,   /* E = 1110 1 */
+                        0x08,   /* F = 1111 0 */
+                        };
+
+/* the same rows in biphase, where a bit in em_bits[] is the level the coil is
+ * left at by each bit, flipping after a one: starting from the level of the 
+ * header's last one, which is where each row ends as well, parity being even.
+ * the level the 2nd half of a bit is sent at & the 1st half of the next. */
+const uint8_t em_bi_rows[16] PROGMEM = {
+                        0xF8,   /* 0 = 0000 0 */
+                        0xE8,   /* 1 = 0001 1 */
+                        0xC8,   /* 2 = 0010 1 */
+                        0xD8,   /* 3 = 0011 0 */
+                        0x88,   /* 4 = 0100 1 */
+                        0x98,   /* 5 = 0101 0 */
+                        0xB8,   /* 6 = 0110 0 */
+                        0xA8,   /* 7 = 0111 1 */
+                        0x08,   /* 8 = 1000 1 */
+                        0x18,   /* 9 = 1001 0 */
+                        0x38,   /* A = 1010 0 */
+                        0x28,   /* B = 1011 1 */
+                        0x78,   /* C = 1100 0 */
+                        0x68,   /* D = 1101 1 */
+                        0x48,   /* E = 1110 1 */
+                        0x58,   /* F = 1111 0 */
+                        };
+#endif
+
+/* sets write_offset & write_mask to manchester bit 'bit' of frame 'frame' */
+static inline void seek_bit(uint8_t frame, uint8_t bit)
+{
+    write_offset = frame + bit / 8;
+    write_mask = 0x80 >> (bit % 8);
+}
+
+/* what a set bit in em_bits[] sends */
+#if PROTOCOL == PROTOCOL_EM41XX
+#define SET_BIT(bit)            (!(bit))
+#else
+#define SET_BIT(bit)            (bit)
+#endif
+
+/* writes a manchester bit to em_bits[] & increment the write_offset */
+static void write_bit(uint8_t bit) 
+{
+    if (!SET_BIT(bit)) {
+        em_bits[write_offset] &= ~write_mask;
+    } else {
+        em_bits[write_offset] |= write_mask;
+    }
+    write_mask >>= 1;
+    if (!write_mask) {
+        write_mask = 0x80;
+        write_offset++;
+    }
+}
+
+#if PROTOCOL == PROTOCOL_EM41XX
+/* writes the bits of 'row' selected by 'mask' to em_bits[], starting with 
+ * the msb at manchester bit 'bit' of frame 'frame' */
+static void write_row(uint8_t frame, uint8_t bit, uint8_t row, uint8_t mask)
+{
+    uint8_t *p = &em_bits[frame + bit / 8];
+    uint16_t r = (row & mask) << 8;
+    uint16_t m = mask << 8;
+    for(uint8_t i = bit % 8; i; i--) {
+        r >>= 1;
+        m >>= 1;
+    }
+    p[0] = (p[0] & ~(m >> 8)) | (r >> 8);
+    /* don't touch the byte after the row unless it's part of it */
+    if ((uint8_t)m) {
+        p[1] = (p[1] & ~m) | r;
+    }
+}
+
+/* writes a nibble with its parity bit as a row from 'rows', em_rows[] or 
+ * em_bi_rows[], xored with 'flip' */
+static void write_nibble(uint8_t frame, uint8_t bit, uint8_t nibble, 
+                         const uint8_t *rows, uint8_t flip) 
+{
+    write_row(frame, bit, pgm_read_byte(&rows[nibble]) ^ flip, ROW_MASK);
+}
+#endif
+
+/* nibble 'i' of a 40bit number, 0 being the highest one */
+static uint8_t get_nibble(const uint8_t *p, uint8_t i)
+{
+    return (i & 1) ? NIBBLE_LOW(p[i / 2]) : NIBBLE_HIGH(p[i / 2]);
+}
+
+static void set_nibble(uint8_t *p, uint8_t i, uint8_t nibble)
+{
+    uint8_t *b = &p[i / 2];
+    *b = (i & 1) ? (*b & 0xF0) | nibble : (*b & 0x0F) | (nibble << 4);
+}
+
+/* packs the wildcard nibbles of 'id' to the low nibbles of 'n', returns their 
+ * number */
+static uint8_t get_wild(uint8_t *n, const uint8_t *id, uint16_t wild)
+{
+    uint8_t k = 10;
+    memset(n, 0, 5);
+    for (int8_t i = 9; i >= 0; i--, wild >>= 1) {
+        if (wild & 1) {
+            set_nibble(n, --k, get_nibble(id, i));
+        }
+    }
+    return 10 - k;
+}
+
+/* unpacks the low nibbles of 'n' to the wildcard nibbles of 'id' */
+static void set_wild(uint8_t *id, const uint8_t *n, uint16_t wild)
+{
+    uint8_t k = 10;
+    for (int8_t i = 9; i >= 0; i--, wild >>= 1) {
+        if (wild & 1) {
+            set_nibble(id, i, get_nibble(n, --k));
+        }
+    }
+}
+
+/* a += b for 40bit numbers, msb first like the IDs. returns the carry */
+static uint8_t add_40(uint8_t *a, const uint8_t *b)
+{
+    uint16_t sum = 0;
+    for (int8_t i = 4; i >= 0; i--) {
+        sum = a[i] + b[i] + (sum >> 8);
+        a[i] = sum;
+    }
+    return sum >> 8;
+}
+
+/* a -= b for 40bit numbers. returns the borrow */
+static uint8_t sub_40(uint8_t *a, const uint8_t *b)
+{
+    uint8_t borrow = 0;
+    for (int8_t i = 4; i >= 0; i--) {
+        uint16_t diff = a[i] - b[i] - borrow;
+        a[i] = diff;
+        borrow = (diff >> 8) & 1;
+    }
+    return borrow;
+}
+
+/* toggle mask of a maximal length galois LFSR of each width, on top of its
+ * highest bit. the LFSR visits all 2^width - 1 non zero numbers. */
+const uint8_t lfsr_taps[41] PROGMEM = {
+     0,  0,  1,  1,  1,  2,  1,  1, 14,  8,  4,  2, 41, 13, 21,  1, 22,  4,
+    19, 19,  4,  2,  1, 16, 13,  4, 35, 19,  4,  2, 41,  4, 87, 41,115,  2,
+    59, 31, 49,  8, 28
+    };
+
+/* clears the nibbles of 'n' above its lowest 'nibbles', returns non zero if 
+ * any of them was set */
+static uint8_t wrap_40(uint8_t *n, uint8_t nibbles)
+{
+    uint8_t over = 0;
+    for (uint8_t i = 0; i < 10 - nibbles; i++) {
+        over |= get_nibble(n, i);
+        set_nibble(n, i, 0);
+    }
+    return over;
+}
+
+/* number of bits needed for the numbers below 'n', at least 2 */
+static uint8_t width_40(const uint8_t *n)
+{
+    uint8_t m[5];
+    const uint8_t one[5] = { 0, 0, 0, 0, 1 };
+    memcpy(m, n, 5);
+    sub_40(m, one);
+    for (uint8_t i = 0; i < 5; i++) {
+        if (m[i]) {
+            uint8_t width = (4 - i) * 8;
+            for (uint8_t b = m[i]; b; b >>= 1) {
+                width++;
+            }
+            return (width < 2) ? 2 : width;
+        }
+    }
+    return 2;
+}
+
+/* steps 'n' to the next number of a permutation of all 'width' bits numbers: 
+ * 0, 1, then the LFSR from 1 until it gets back to 1, which is 0's turn. */
+static void step_lfsr(uint8_t *n, uint8_t width)
+{
+    if (!(n[0] | n[1] | n[2] | n[3] | n[4])) {
+        n[4] = 1;
+        return;
+    }
+    uint8_t lsb = n[4] & 1, carry = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        uint8_t b = n[i];
+        n[i] = (b >> 1) | carry;
+        carry = b << 7;
+    }
+    if (lsb) {
+        n[4] ^= pgm_read_byte(&lfsr_taps[width]);
+        n[4 - (width - 1) / 8] |= 1 << ((width - 1) % 8);
+    }
+    if (!(n[0] | n[1] | n[2] | n[3]) && n[4] == 1) {
+        n[4] = 0;
+    }
+}
+
+/* steps 'n' to the next number of the 'width' bit gray code, flipping one bit
+ * of it, 1 if it's back to zero */
+static uint8_t step_gray(uint8_t *n, uint8_t width)
+{
+    uint8_t parity = 0, bit = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        parity ^= parity_even_bit(n[i]);
+    }
+    /* even parity flips bit 0, odd the one above the lowest set bit, which is
+     * the top bit past the last number */
+    if (parity) {
+        while (!(n[4 - bit / 8] & (1 << (bit % 8)))) {
+            bit++;
+        }
+        if (++bit == width) {
+            bit--;
+        }
+    }
+    n[4 - bit / 8] ^= 1 << (bit % 8);
+    return !(n[0] | n[1] | n[2] | n[3] | n[4]);
+}
+
+/* steps 'id' to the next ID of em_dict[], or its 1st one after the last one */
+static void next_dict(uint8_t *id)
+{
+    uint8_t b, bit = 0;
+    uint8_t n[5] = { 0 };
+
+    if (!sizeof(em_dict)) {
+        return;
+    }
+    if (dict_offset >= sizeof(em_dict)) {
+        memset(id, 0, 5);
+        dict_offset = 0;
+    }
+
+    /* the difference to the ID before, 7 bits at a time */
+    do {
+        b = pgm_read_byte(&em_dict[dict_offset++]);
+        for (uint8_t i = 0; i < 7 && bit < 40; i++, bit++) {
+            if (b & (1 << i)) {
+                n[4 - bit / 8] |= 1 << (bit % 8);
+            }
+        }
+    } while ((b & 0x80) && dict_offset < sizeof(em_dict));
+
+    add_40(id, n);
+}
+
+/* loads the start of every range in em_ranges[] to em_id_list[] */
+static void load_em_ranges(void)
+{
+    dict_offset = sizeof(em_dict);
+    for (uint8_t i = 0; i < RANGES; i++) {
+        memcpy_P(&em_id_list[i * 5], em_ranges[i].start, 5);
+        if (pgm_read_byte(&em_ranges[i].order) == ORDER_DICT) {
+            next_dict(&em_id_list[i * 5]);
+        }
+    }
+}
+
+/* steps the current ID to the next one of its range, by the range's stride or
+ * its permutation, and starts the range over once at its end. 1 if it did */
+static uint8_t inc_em_id(void)
+{
+    em_range_t range;
+    uint8_t *id = &em_id_list[read_offset_id];
+    uint8_t n[5], first[5], last[5], over;
+    memcpy_P(&range, &em_ranges[read_range], sizeof(range));
+
+    if (range.order == ORDER_DICT) {
+        over = dict_offset >= sizeof(em_dict);
+        next_dict(id);
+        return over;
+    }
+
+    /* work on the wildcard nibbles only, as a number of their own */
+    uint8_t nibbles = get_wild(n, id, range.wild);
+    if (!nibbles) {
+        return 1;
+    }
+    get_wild(first, range.start, range.wild);
+    get_wild(last, range.end, range.wild);
+    uint8_t end = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        end |= range.end[i];
+    }
+
+    /* no permutation gets below an end of 0, so random ranges of one ID or
+     * none step like a stride */
+    if (range.order == ORDER_RANDOM && end) {
+        uint8_t size[5];
+        memcpy(size, last, 5);
+        if (sub_40(size, first) ||
+            (!(size[0] | size[1] | size[2] | size[3]) && size[4] <= 1)) {
+            range.order = ORDER_STRIDE;
+            range.stride = 1;
+        }
+    }
+
+    if (range.order == ORDER_GRAY) {
+        /* the gray code of the offset, xored onto the start of the range */
+        for (uint8_t i = 0; i < 5; i++) {
+            n[i] ^= first[i];
+        }
+        over = step_gray(n, nibbles * 4);
+        for (uint8_t i = 0; i < 5; i++) {
+            n[i] ^= first[i];
+        }
+    } else if (range.order == ORDER_RANDOM) {
+        /* permute the offset from the start of the range, walking past the
+         * numbers which are beyond its end */
+        uint8_t width = nibbles * 4;
+        sub_40(n, first);
+        wrap_40(n, nibbles);
+        if (end) {
+            sub_40(last, first);
+            width = width_40(last);
+        }
+        do {
+            step_lfsr(n, width);
+        } while (end && memcmp(n, last, 5) >= 0);
+        /* the permutation starts over at the start of the range */
+        over = !(n[0] | n[1] | n[2] | n[3] | n[4]);
+        add_40(n, first);
+    } else {
+        const uint8_t stride[5] = { 0, 0, 0, range.stride >> 8, range.stride };
+        over = add_40(n, stride);
+        over |= wrap_40(n, nibbles);
+        /* wrapped around or got to the end of the range? */
+        if (end && (over || memcmp(n, last, 5) >= 0)) {
+            memcpy(n, first, 5);
+            over = 1;
+        }
+    }
+
+    set_wild(id, n, range.wild);
+    return over;
+}
+
+/* each protocol encodes its frames with write_header(frame), writing the bits
+ * of the frame at offset 'frame' in em_bits[] which don't depend on the ID, 
+ * and write_id(frame), writing the current ID from em_id_list[] to it. 
+ * clear_id(frame) makes the next write_id() write the whole ID again. */
+#if PROTOCOL == PROTOCOL_EM41XX
+/* non zero if frame 'frame' in em_bits[] is sent in the other polarity, which
+ * the 1st bit of its header tells: a one is a clear bit in manchester, & a 
+ * set bit in biphase, the level before it being the low one */
+static uint8_t frame_flip(uint8_t frame)
+{
+    return (em_bits[frame] >> 7) ^ (profile.encoding == ENCODING_BIPHASE);
+}
+
+/* sends frame 'frame' in em_bits[] in the other polarity */
+static void invert_frame(uint8_t frame)
+{
+    for(uint8_t i = 0; i < FRAME_SIZE; i++) {
+        em_bits[frame + i] ^= 0xFF;
+    }
+}
+
+/* sets the polarity of frame 'frame' in em_bits[], which goes on air right 
+ * after frame 'last': always the other one with ENCODING_INVERTED, the other
+ * one than 'last' with ENCODING_ALTERNATE & for biphase, the one starting at
+ * the level 'last' ends at, so the bits go on across frames */
+static void set_polarity(uint8_t frame, uint8_t last)
+{
+    uint8_t flip;
+    if (profile.encoding == ENCODING_INVERTED) {
+        flip = 1;
+    } else if (profile.encoding == ENCODING_ALTERNATE) {
+        flip = !frame_flip(last);
+    } else if (profile.encoding == ENCODING_BIPHASE) {
+        flip = em_bits[last + FRAME_SIZE - 1] & 1;
+    } else {
+        return;
+    }
+    if (frame_flip(frame) != flip) {
+        invert_frame(frame);
+    }
+}
+
+/* writes a static header (9 ones) at the begining of frame 'frame' in 
+ * em_bits[] and a stop bit (zero) at its end */
+static void write_header(uint8_t frame) 
+{
+    seek_bit(frame, 0);
+    for(uint8_t i = 0; i < 9; i++) {
+        /* in biphase the level flips after each of the ones */
+        write_bit(profile.encoding != ENCODING_BIPHASE || (i & 1));
+    }
+    seek_bit(frame, FRAME_BITS - 1);
+    write_bit(0);
+}
+
+/* translates current ID from em_id_list[] to manchester (or biphase) encoding
+ * and writes to the frame at offset 'frame' in em_bits[], in the polarity the
+ * frame is in. only the rows of nibbles which differ from the ID already in 
+ * the frame are written, plus the checksum.
+ */
+static void write_id(uint8_t frame) 
+{
+    uint8_t checksum = 0;
+    uint8_t *frame_id = em_frame_id[frame / FRAME_SIZE];
+    uint8_t biphase = profile.encoding == ENCODING_BIPHASE;
+    const uint8_t *rows = biphase ? em_bi_rows : em_rows;
+    uint8_t flip = frame_flip(frame) ? 0xFF : 0x00;
+    for(uint8_t i = 0; i < 5; i++) {
+        uint8_t c = read_byte(i);
+        uint8_t diff = c ^ frame_id[i];
+        checksum ^= c;
+        frame_id[i] = c;
+        if (NIBBLE_HIGH(diff)) {
+            write_nibble(frame, 9 + i * 10, NIBBLE_HIGH(c), rows, flip);
+        }
+        if (NIBBLE_LOW(diff)) {
+            write_nibble(frame, 14 + i * 10, NIBBLE_LOW(c), rows, flip);
+        }
+    }
+    /* the column parity nibble has no row parity of its own */
+    checksum = NIBBLE_HIGH(checksum) ^ NIBBLE_LOW(checksum);
+    uint8_t row = pgm_read_byte(&rows[checksum]);
+    if (biphase) {
+        /* the stop bit stays at the level of the last column parity bit */
+        row = (row & DATA_MASK) | ((row >> 1) & 0x08);
+        write_row(frame, 59, row ^ flip, ROW_MASK);
+    } else {
+        write_row(frame, 59, row ^ flip, DATA_MASK);
+    }
+}
+
+/* makes the next write_id() to frame 'frame' write all of its rows */
+static void clear_id(uint8_t frame)
+{
+    uint8_t *frame_id = em_frame_id[frame / FRAME_SIZE];
+    for(uint8_t i = 0; i < 5; i++) {
+        frame_id[i] = ~read_byte(i);
+    }
+}
+
+#elif PROTOCOL == PROTOCOL_HID
+/* writes the preamble at the begining of frame 'frame' in em_bits[] */
+static void write_header(uint8_t frame)
+{
+    seek_bit(frame, 0);
+    for(uint8_t mask = 0x80; mask; mask >>= 1) {
+        write_bit(HID_PREAMBLE & mask);
+    }
+}
+
+/* translates current ID from em_id_list[] to HID_FORMAT & writes its 44 bits,
+ * manchester encoded, after the preamble of frame 'frame' in em_bits[] */
+static void write_id(uint8_t frame)
+{
+    uint8_t id[5];
+    for(uint8_t i = 0; i < 5; i++) {
+        id[i] = read_byte(i);
+        em_frame_id[frame / FRAME_SIZE][i] = id[i];
+    }
+#if HID_FORMAT == 26
+    /* the even parity of the facility & the card's 4 high bits, the facility,
+     * the card & the odd parity of its 12 low bits, after the 0x2004 header */
+    uint8_t even = parity_even_bit(id[2]) ^ parity_even_bit(NIBBLE_HIGH(id[3]));
+    uint8_t odd = !(parity_even_bit(NIBBLE_LOW(id[3])) ^
+                    parity_even_bit(id[4]));
+    uint32_t wiegand = (uint32_t)even << 25 | (uint32_t)id[2] << 17 |
+                       (uint32_t)(id[3] << 8 | id[4]) << 1 | odd;
+    id[0] = 0x20;
+    id[1] = 0x04 | (uint8_t)(wiegand >> 24);
+    id[2] = wiegand >> 16;
+    id[3] = wiegand >> 8;
+    id[4] = wiegand;
+#elif HID_FORMAT != 0
+#error "HID_FORMAT must be 26 or 0"
+#endif
+
+    /* the 4 bits above the ID are zeros, a one is sent as 10 & a zero as 01 */
+    seek_bit(frame, 8);
+    for(uint8_t i = 0; i < 4; i++) {
+        write_bit(0);
+        write_bit(1);
+    }
+    for(uint8_t i = 0; i < 5; i++) {
+        for(uint8_t mask = 0x80; mask; mask >>= 1) {
+            uint8_t bit = id[i] & mask;
+            write_bit(bit);
+            write_bit(!bit);
+        }
+    }
+}
+
+/* write_id() writes all of the bits anyway */
+static void clear_id(uint8_t frame)
+{
+    (void)frame;
+}
+#else
+/* writes the preamble, 1010 & 28 zeros (0xA0000000), at the begining of 
+ * frame 'frame' in em_bits[]. the sync one after it is written with the ID */
+static void write_header(uint8_t frame)
+{
+    seek_bit(frame, 0);
+    for(uint8_t i = 0; i < 32; i++) {
+        write_bit(i == 0 || i == 2);
+    }
+}
+
+/* writes the last 4 bytes of the current ID from em_id_list[] after the 
+ * preamble of frame 'frame' in em_bits[], one bit per bit */
+static void write_id(uint8_t frame)
+{
+    for(uint8_t i = 0; i < 5; i++) {
+        em_frame_id[frame / FRAME_SIZE][i] = read_byte(i);
+    }
+    for(uint8_t i = 1; i < 5; i++) {
+        em_bits[frame + 3 + i] = read_byte(i);
+    }
+    /* bit 32 is the sync one, in place of the top bit of the ID's 2nd byte */
+    em_bits[frame + 4] |= 0x80;
+}
+
+/* write_id() writes all of the bits anyway */
+static void clear_id(uint8_t frame)
+{
+    (void)frame;
+}
+#endif
+
+
+/* copies frame 'src' in em_bits[] to frame 'dst' */
+static void copy_em_id(uint8_t dst, uint8_t src)
+{
+    for(uint8_t i = 0; i < FRAME_SIZE; i++) {
+        em_bits[dst + i] = em_bits[src + i];
+    }
+    for(uint8_t i = 0; i < 5; i++) {
+        em_frame_id[dst / FRAME_SIZE][i] = em_frame_id[src / FRAME_SIZE][i];
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * the frames of zigfrid & the ranges of IDs which go in them, shared by its
+ * encoders & generators in frames.c. neither needs anything of the AVR but 
+ * its flash access, so both build natively too, see tools/native.c.
+ */
+
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#include <util/parity.h>
+#else
+/* the host reads the tables off plain memory */
+#define PROGMEM
+#define pgm_read_byte(p)        (*(const uint8_t *)(p))
+#define memcpy_P                memcpy
+#define parity_even_bit(x)      __builtin_parity(x)
+#endif
+
+/* a range of em_ranges[], see there */
+typedef struct {
+    uint8_t start[5];
+    uint8_t end[5];
+    uint16_t wild;
+    uint16_t stride;
+    uint8_t order;
+    uint8_t weight;
+} em_range_t;
+
+#define ID(a, b, c, d, e)       { a, b, c, d, e }
+#define ANY                     0x3FF
+
+#define ORDER_STRIDE            0
+#define ORDER_RANDOM            1
+#define ORDER_DICT              2
+#define ORDER_GRAY              3
+
+#define DEPTH_FIRST             0xFF
+
+/* a range sending the IDs of em_dict[] */
+#define DICT                    { ID(0,0,0,0,0), ID(0,0,0,0,0), 0, 0, \
+                                  ORDER_DICT }
+
+/* number of ranges in em_ranges[] */
+#define RANGES                  (sizeof(em_ranges) / sizeof(em_range_t))
+
+/* the most ranges the byte offsets into em_id_list[] & the checkpoint reach,
+ * read_offset_id being range * 5 & checkpoint_offset up to 5 * RANGES + 5 */
+#define MAX_RANGES              50
+
+/* the encodings of profile_t, see profiles[] */
+#define ENCODING_MANCHESTER     0
+#define ENCODING_INVERTED       1
+#define ENCODING_ALTERNATE      2
+#define ENCODING_BIPHASE        3
+
+/* the protocols PROTOCOL picks, see zigfrid.c */
+#define PROTOCOL_EM41XX         0
+#define PROTOCOL_HID            1
+#define PROTOCOL_INDALA         2
+
+#ifndef PROTOCOL
+#define PROTOCOL                PROTOCOL_EM41XX
+#endif
+#ifndef HID_FORMAT
+#define HID_FORMAT              26
+#endif
+
+/* the start of a HID frame, 3 fc/8 symbols, 3 fc/10, fc/8 & fc/10, which 
+ * isn't valid manchester */
+#define HID_PREAMBLE            0x1D
+
+/* get nibbles of a byte */
+#define NIBBLE_HIGH(x)          (x >> 4)
+#define NIBBLE_LOW(x)           (x & 0x0F)
+
+/* number of bits in one frame (manchester bits of EM41xx, FSK symbols of HID)
+ * & bytes they're packed in */
+#if PROTOCOL == PROTOCOL_HID
+#define FRAME_BITS              96
+#else
+#define FRAME_BITS              64
+#endif
+#define FRAME_SIZE              (FRAME_BITS / 8)
+
+#endif
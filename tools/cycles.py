@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+#
+# sums the cycles of every path through the interrupt call in zigfrid.elf &
+# fails if the worst of them, with the interrupt response & vector jump, is
+# over the budget: a percentage of the time between two calls, or if it 
+# doesn't fit between them when waking the main loop up. the call is naked,
+# so any push or pop the compiler adds fails it too, & so does a push of a
+# register the build pins a global to anywhere else, e.g. in libgcc or 
+# avr-libc, which don't know about the pins & would clobber them.
+#
+# reads the defines of the build ('avr-gcc ... -dM -E zigfrid.c') on stdin to
+# tell which interrupt call is built & how often it's called, & the source
+# ('avr-gcc ... -E zigfrid.c') for the registers pinned.
+#
+# usage: (avr-gcc ... -dM -E zigfrid.c; avr-gcc ... -E zigfrid.c) | 
+#        cycles.py [-b 90] [-v] zigfrid.elf
+
+import argparse
+import re
+import subprocess
+import sys
+
+RESPONSE = 4
+# & 4 more when it wakes the main loop up from sleep, which has nothing to do
+# then, so that only has to fit the period
+WAKEUP = 4
+# or up to 3 more finishing the instruction it interrupts (ret, reti), so the
+# edges the timer calls send jitter by the larger of both
+FINISH = 3
+
+# the cycles of each instruction on the attiny85, branches & skips not taken
+CYCLES = {
+    'ld': 2, 'ldd': 2, 'st': 2, 'std': 2, 'lds': 2, 'sts': 2,
+    'lpm': 3, 'push': 2, 'pop': 2, 'adiw': 2, 'sbiw': 2, 'sbi': 2, 'cbi': 2,
+    'rjmp': 2, 'ijmp': 2, 'rcall': 3, 'icall': 3, 'ret': 4, 'reti': 4,
+}
+BRANCHES = ('brbs', 'brbc', 'breq', 'brne', 'brcs', 'brcc', 'brsh', 'brlo',
+            'brmi', 'brpl', 'brge', 'brlt', 'brhs', 'brhc', 'brts', 'brtc',
+            'brvs', 'brvc', 'brie', 'brid')
+SKIPS = ('sbrs', 'sbrc', 'sbis', 'sbic', 'cpse')
+
+# the vector of each interrupt call
+VECTORS = {'TIMER1_COMPA_vect': 3, 'TIMER0_COMPA_vect': 10, 'USI_OVF_vect': 14}
+
+
+class Insn:
+    def __init__(self, addr, size, op, args, target):
+        self.addr, self.size, self.op = addr, size, op
+        self.args, self.target = args, target
+
+
+def disassemble(objdump, elf):
+    """the instructions of 'elf' by address"""
+    out = subprocess.run([objdump, '-d', elf], check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True)
+    insns = {}
+    for line in out.stdout.splitlines():
+        m = re.match(r'\s*([0-9a-f]+):\t((?:[0-9a-f]{2} )+)\s+(\S+)\s*([^;]*)'
+                     r'(?:;\s*0x([0-9a-f]+))?', line)
+        if m:
+            addr = int(m.group(1), 16)
+            target = int(m.group(5), 16) if m.group(5) else None
+            insns[addr] = Insn(addr, len(m.group(2).split()), m.group(3),
+                               m.group(4).strip(), target)
+    return insns
+
+
+def paths(insns, addr, seen=()):
+    """the cycles & instructions of every path from 'addr' to its reti"""
+    if addr in seen:
+        sys.exit('loop at 0x%x' % addr)
+    insn = insns.get(addr)
+    if insn is None:
+        sys.exit('no instruction at 0x%x' % addr)
+    if not re.match(r'[a-z]+$', insn.op):
+        sys.exit('no cycles for %s at 0x%x' % (insn.op, addr))
+    seen = seen + (addr,)
+    cycles = CYCLES.get(insn.op, 1)
+    following = addr + insn.size
+
+    if insn.op in ('push', 'pop'):
+        sys.exit('%s in the naked interrupt call at 0x%x' % (insn.op, addr))
+    if insn.op in ('reti', 'ret'):
+        return [(cycles, [insn])]
+    if insn.op in ('ijmp', 'icall', 'rcall', 'call', 'eijmp', 'eicall'):
+        sys.exit('can\'t follow %s at 0x%x' % (insn.op, addr))
+    if insn.op in ('rjmp', 'jmp'):
+        nexts = [(insn.target, cycles)]
+    elif insn.op in BRANCHES:
+        nexts = [(following, 1), (insn.target, 2)]
+    elif insn.op in SKIPS:
+        if following not in insns:
+            sys.exit('no instruction to skip at 0x%x' % following)
+        skipped = insns[following].size
+        nexts = [(following, 1), (following + skipped, 1 + skipped // 2)]
+    else:
+        nexts = [(following, cycles)]
+
+    found = []
+    for to, c in nexts:
+        for total, trace in paths(insns, to, seen):
+            found.append((total + c, [insn] + trace))
+    return found
+
+
+def main():
+    ap = argparse.ArgumentParser(description='check the interrupt cycles')
+    ap.add_argument('elf')
+    ap.add_argument('-b', '--budget', type=float, default=90,
+                    help='percent of the time between calls')
+    ap.add_argument('--objdump', default='avr-objdump')
+    ap.add_argument('-v', '--verbose', action='store_true')
+    args = ap.parse_args()
+
+    source = sys.stdin.read()
+    defines = dict(re.findall(r'#define (\w+)(?: (.*))?', source))
+    pinned = set(re.findall(r'register\s+\w+\s+\w+\s+__asm__\s*\(\s*"(r\d+)"',
+                            source))
+    rate = int(defines.get('DATA_RATE', '64'))
+    protocol = defines.get('PROTOCOL', '0')
+    protocol = defines.get(protocol, protocol)
+    if 'RATE_PROBE' in defines:
+        rate = 32
+    if protocol != '0':
+        # HID & Indala, timer1 calls it once per bit
+        name, period = 'TIMER1_COMPA_vect', rate
+    elif 'OUTPUT_USI' in defines:
+        name, period = 'USI_OVF_vect', 8 * rate // 2
+    else:
+        name, period = 'TIMER0_COMPA_vect', rate // 2
+
+    # a listing this doesn't parse would pass with no paths or the wrong ones
+    insns = disassemble(args.objdump, args.elf)
+    if not insns:
+        sys.exit('no instructions in the %s output' % args.objdump)
+    vector = insns.get(VECTORS[name] * 2)
+    if vector is None or vector.op != 'rjmp' or vector.target is None:
+        sys.exit('%s isn\'t a rjmp in the %s output' % (name, args.objdump))
+
+    for insn in insns.values():
+        if insn.op == 'push' and insn.args in pinned:
+            sys.exit('push of the pinned %s at 0x%x' % (insn.args, insn.addr))
+
+    found = paths(insns, vector.target)
+    overhead = RESPONSE + CYCLES['rjmp']
+    worst = max(found, key=lambda p: p[0])
+    budget = period * args.budget / 100
+
+    if args.verbose:
+        for total, trace in sorted(found, key=lambda p: p[0]):
+            print('%3d: %s' % (total + overhead,
+                               ' '.join(i.op for i in trace)))
+    print('%s: %d to %d cycles of %d (%d%% budget %.1f)' %
+          (name, min(p[0] for p in found) + overhead, worst[0] + overhead,
+           period, args.budget, budget))
+    print('%s: %d cycles when waking up (of %d)' %
+          (name, worst[0] + overhead + WAKEUP, period))
+    if name == 'USI_OVF_vect' or protocol == defines.get('PROTOCOL_HID'):
+        print('%s: the hardware times the edges' % name)
+    else:
+        print('%s: starts %d to %d cycles after its flag, %d waking up, '
+              'edges jitter by up to %d' %
+              (name, overhead, overhead + FINISH, overhead + WAKEUP,
+               max(FINISH, WAKEUP)))
+    late = max(FINISH, WAKEUP)
+    if worst[0] + overhead > budget or worst[0] + overhead + late > period:
+        print('FAIL: over the budget by:')
+        for i in worst[1]:
+            print('  %4x: %s %s' % (i.addr, i.op, i.args))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,291 @@
+#!/usr/bin/env python3
+#
+# compiles a list of EM41xx IDs to a header of em_ranges[] & em_dict[] for
+# zigfrid.c, and reports the flash it takes & how long a sweep of it lasts.
+#
+# one entry per line, '#' starts a comment:
+#
+#   0A42001234                  a single ID, also as 0x0A42001234 or
+#   0A:42:00:12:34              with ':', '-' or ' ' between the bytes
+#   66/12345  or  66,12345      facility & card number, in decimal
+#   some,csv,0A42001234,fields  a CSV line, the 1st field which is an ID
+#   0A42??????                  a range, '?' being the wildcard nibbles
+#   0A42000000..0A4200FFFF      a range of IDs, the last one included
+#
+# ranges can be followed by 'stride=N', 'random', 'gray' to walk all of its
+# wildcards in gray code, for constant time ID switches, 'weight=N' for N IDs
+# per turn of the range & 'depth' to send it all through in its turn. single
+# IDs go, sorted, to the dictionary & a DICT range sends them.
+#
+# facility/card pairs are the 3rd byte & the last two of the ID, which is what
+# HID_FORMAT 26 sends as well. --protocol sets the frames of the estimate.
+#
+# usage: ids.py [-o ids.h] [--profile N] [--repeat N] [--rate 64]
+#               [--protocol em|hid|indala] file...
+
+import argparse
+import re
+import sys
+
+# the bits per frame & carrier cycles per bit of each protocol, EM41xx's rate
+# being --rate
+PROTOCOLS = {'em': (64, None), 'hid': (96, 50), 'indala': (64, 32)}
+CARRIER = 125000
+RANGE_SIZE = 16         # sizeof(em_range_t)
+DEPTH_FIRST = 0xFF
+RAM_PER_RANGE = 15      # em_id_list[], the checkpoint & its copy at boot
+MAX_RANGES = 50         # as in frames.h, for its byte offsets
+
+
+class Range:
+    def __init__(self, start, end, wild, stride=1, order='ORDER_STRIDE',
+                 weight=1):
+        self.start, self.end, self.wild = start, end, wild
+        self.stride, self.order, self.weight = stride, order, weight
+
+    def wild_value(self, n):
+        """the wildcard nibbles of 'n' as a number of their own"""
+        v = 0
+        for i in range(9, -1, -1):
+            if self.wild & (1 << i):
+                v = v << 4 | (n >> (i * 4)) & 0xF
+        return v
+
+    def size(self):
+        nibbles = bin(self.wild).count('1')
+        if self.order == 'ORDER_GRAY':
+            return 16 ** nibbles
+        first = self.wild_value(self.start)
+        last = self.wild_value(self.end) if self.end else 16 ** nibbles
+        count = max(last - first, 0)
+        if self.order == 'ORDER_STRIDE':
+            count = -(-count // self.stride)
+        return count
+
+
+def parse_id(s):
+    s = re.sub(r'[:\- ]', '', s.strip())
+    if s.lower().startswith('0x'):
+        s = s[2:]
+    if not re.fullmatch(r'[0-9A-Fa-f]{10}', s):
+        return None
+    return int(s, 16)
+
+
+def parse_range(text, options, where):
+    stride, order, weight = 1, 'ORDER_STRIDE', 1
+    for opt in options:
+        if opt in ('random', 'gray'):
+            order = 'ORDER_' + opt.upper()
+        elif opt == 'depth':
+            weight = DEPTH_FIRST
+        elif opt.startswith('stride='):
+            stride = int(opt[7:], 0)
+            if not 0 < stride < 0x10000:
+                sys.exit('%s: stride out of range' % where)
+        elif opt.startswith('weight='):
+            weight = int(opt[7:], 0)
+            if not 0 < weight < DEPTH_FIRST:
+                sys.exit('%s: weight out of range' % where)
+        else:
+            sys.exit('%s: unknown option %s' % (where, opt))
+
+    if '..' in text:
+        first, last = (parse_id(x) for x in text.split('..'))
+        if first is None or last is None or last < first:
+            sys.exit('%s: bad range %s' % (where, text))
+        # vary the nibbles from the highest one which differs down, & the 
+        # ones above as well while the end carries into them
+        top = 9
+        while top > 0 and (first ^ last) >> (top * 4) & 0xF == 0:
+            top -= 1
+        low = (1 << ((top + 1) * 4)) - 1
+        if first & low == 0 and last & low == low:
+            end = 0
+        else:
+            end = last + 1
+            while (top < 9 and
+                   end >> ((top + 1) * 4) != first >> ((top + 1) * 4)):
+                top += 1
+            if end >> 40:
+                sys.stderr.write('%s: wraps around to 0000000000\n' % where)
+                end = 0
+        wild = (1 << (top + 1)) - 1
+        if end and order == 'ORDER_GRAY':
+            sys.exit('%s: gray goes over all the wildcards, %s has an end' %
+                     (where, text))
+        return checked(Range(first, end, wild, stride, order, weight), where,
+                       text)
+
+    s = re.sub(r'[:\- ]', '', text)
+    if s.lower().startswith('0x'):
+        s = s[2:]
+    if not re.fullmatch(r'[0-9A-Fa-f?]{10}', s):
+        sys.exit('%s: bad range %s' % (where, text))
+    wild = 0
+    for i, c in enumerate(s):
+        if c == '?':
+            wild |= 1 << (9 - i)
+    return checked(Range(int(s.replace('?', '0'), 16), 0, wild, stride, order,
+                         weight), where, text)
+
+
+def checked(r, where, text):
+    if r.size() < 1:
+        sys.exit('%s: empty range %s' % (where, text))
+    return r
+
+
+def parse(files):
+    ids, ranges = set(), []
+    for name in files:
+        for n, line in enumerate(open(name), 1):
+            where = '%s:%d' % (name, n)
+            line = line.split('#')[0].strip()
+            if not line:
+                continue
+            words = line.split()
+            if '?' in words[0] or '..' in words[0]:
+                r = parse_range(words[0], words[1:], where)
+                if (r.end and r.size() == 1 and r.order == 'ORDER_STRIDE' and
+                        r.weight == 1):
+                    ids.add(r.start)
+                else:
+                    ranges.append(r)
+                continue
+            i = parse_id(line)
+            if i is None:
+                fields = [f.strip() for f in re.split(r'[,;/\t]', line)]
+                for f in fields:
+                    i = parse_id(f)
+                    if i is not None:
+                        break
+                else:
+                    if len(fields) == 2 and all(f.isdigit() for f in fields):
+                        facility, card = (int(f) for f in fields)
+                        if facility > 0xFF or card > 0xFFFF:
+                            sys.exit('%s: facility or card too big' % where)
+                        i = facility << 16 | card
+            if i is None:
+                sys.exit('%s: no ID in "%s"' % (where, line))
+            ids.add(i)
+    return sorted(ids), ranges
+
+
+def varint(n):
+    out = []
+    while True:
+        out.append(n & 0x7F | (0x80 if n >> 7 else 0))
+        n >>= 7
+        if not n:
+            return out
+
+
+def id_bytes(n):
+    return 'ID(%s)' % ','.join('0x%02X' % (n >> s & 0xFF)
+                               for s in (32, 24, 16, 8, 0))
+
+
+def profile_repeat(profile):
+    """the repeat of profiles[profile] in zigfrid.c"""
+    src = open(__file__.rsplit('/', 2)[0] + '/zigfrid.c').read()
+    table = re.search(r'profiles\[\] PROGMEM = \{(.*?)\n\s*\};', src, re.S)
+    repeats = re.findall(r'\{\s*(\d+)', table.group(1)) if table else []
+    if profile >= len(repeats):
+        sys.exit('no profile %d in zigfrid.c' % profile)
+    return int(repeats[profile])
+
+
+def duration(seconds):
+    for unit, size in (('days', 86400), ('hours', 3600), ('minutes', 60)):
+        if seconds >= size * 2:
+            return '%.1f %s' % (seconds / size, unit)
+    return '%.1f seconds' % seconds
+
+
+def main():
+    ap = argparse.ArgumentParser(description='compile EM41xx IDs for zigfrid')
+    ap.add_argument('files', nargs='+')
+    ap.add_argument('-o', '--output')
+    ap.add_argument('--profile', type=int)
+    ap.add_argument('--repeat', type=int)
+    ap.add_argument('--rate', type=int, default=64, choices=(32, 64))
+    ap.add_argument('--protocol', default='em', choices=sorted(PROTOCOLS))
+    args = ap.parse_args()
+
+    ids, ranges = parse(args.files)
+    if not ids and not ranges:
+        sys.exit('no IDs found')
+    if len(ranges) + (1 if ids else 0) > MAX_RANGES:
+        sys.exit('%d ranges, zigfrid.c takes %d at most, the dictionary '
+                 'being one' % (len(ranges) + (1 if ids else 0), MAX_RANGES))
+
+    dict_bytes = []
+    prev = 0
+    for i in ids:
+        dict_bytes += varint(i - prev)
+        prev = i
+
+    out = ['/* generated by tools/ids.py from %s, don\'t edit */' %
+           ' '.join(args.files), '']
+    if args.profile is not None:
+        out += ['#ifndef PROFILE',
+                '#define PROFILE                 %d' % args.profile,
+                '#endif', '']
+    out.append('const em_range_t em_ranges[] PROGMEM = {')
+    for r in ranges:
+        line = '    { %s, %s, 0x%03X, %d' % (id_bytes(r.start), id_bytes(r.end),
+                                             r.wild, r.stride)
+        if r.weight == DEPTH_FIRST:
+            line += ', %s, DEPTH_FIRST' % r.order
+        elif r.weight != 1:
+            line += ', %s, %d' % (r.order, r.weight)
+        elif r.order != 'ORDER_STRIDE':
+            line += ', ' + r.order
+        out.append(line + ' },')
+    if ids:
+        out.append('    DICT,')
+    out += ['    };', '', 'const uint8_t em_dict[] PROGMEM = {']
+    for i in range(0, len(dict_bytes), 12):
+        out.append('    ' + ' '.join('0x%02X,' % b
+                                     for b in dict_bytes[i:i + 12]))
+    out += ['    };', '']
+
+    if args.output:
+        open(args.output, 'w').write('\n'.join(out))
+    else:
+        print('\n'.join(out))
+
+    # the report, a turn being each range's weight of IDs or all of a depth
+    # first one
+    count = len(ranges) + (1 if ids else 0)
+    repeat = args.repeat or profile_repeat(args.profile or 0)
+    frame_bits, rate = PROTOCOLS[args.protocol]
+    rate = rate or args.rate
+    frame = frame_bits * rate / CARRIER
+    sizes = [r.size() for r in ranges] + ([len(ids)] if ids else [])
+    weights = [r.weight for r in ranges] + ([1] if ids else [])
+    turn = sum(size if w == DEPTH_FIRST else w
+               for size, w in zip(sizes, weights)) * repeat * frame
+    sweeps = [size * repeat * frame if w == DEPTH_FIRST else
+              -(-size // w) * turn for size, w in zip(sizes, weights)]
+    flash = count * RANGE_SIZE + len(dict_bytes)
+    report = sys.stderr.write
+    report('%d ranges, %d IDs in the dictionary\n' % (len(ranges), len(ids)))
+    report('flash: %d bytes (%d of em_ranges[], %d of em_dict[])\n' %
+           (flash, count * RANGE_SIZE, len(dict_bytes)))
+    report('ram: %d bytes\n' % (count * RAM_PER_RANGE))
+    report('%d frames per ID at RF/%d, %.1f IDs per second\n' %
+           (repeat, rate, 1 / (repeat * frame)))
+    for r, size, sweep in zip(ranges + ([None] if ids else []), sizes, sweeps):
+        name = 'dictionary' if r is None else '%010X' % r.start
+        report('  %s: %d IDs in %s\n' % (name, size, duration(sweep)))
+    report('whole sweep: %s\n' % duration(max(max(sweeps), turn)))
+    if count * RAM_PER_RANGE > 300:
+        report('warning: too many ranges for the ram\n')
+    if flash > 5000:
+        report('warning: likely too big for the flash, check avr-size\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,674 @@
+/*
+ * builds the frame encoders & the ID generators of frames.c on the host,
+ * checks the frames they write with a decoder of its own, on the half bits
+ * (symbols, bits) the reader gets, & reports the time per ID of each range's
+ * generator & of each encoder on its IDs. the ranges are the em_ranges[] of
+ * IDS_H, as make native IDS=file.txt passes it, or one of each order below.
+ * PROTOCOL & HID_FORMAT pick the encoders as in zigfrid.c, EM41xx runs all
+ * of its encodings.
+ * it fails when a frame doesn't decode to its ID, the golden IDs don't make
+ * the frames below, or an ID is off its range or a whole sweep doesn't send
+ * each of its IDs once.
+ * the times are TSC ticks on x86 & nanoseconds elsewhere, of the host, so
+ * they only compare builds of the same machine.
+ *
+ * usage: native [-n IDs] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frames.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICKS               "cycles"
+static uint64_t ticks(void)
+{
+    return __rdtsc();
+}
+#else
+#define TICKS               "ns"
+static uint64_t ticks(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+#endif
+
+#ifndef RING_FRAMES
+#define RING_FRAMES         2
+#endif
+/* frames per ID of the check, the 2nd a copy of the 1st as with repeats */
+#define REPEAT              2
+/* timed runs of each range & encoder */
+#define RUNS                5
+
+#ifdef IDS_H
+#include IDS_H
+#else
+const em_range_t em_ranges[] PROGMEM = {
+    /* a carry through all of the 4 wildcard nibbles every 65536 IDs */
+    { ID(0x0A,0x42,0x00,0x00,0x00), ID(0,0,0,0,0), 0x00F, 1 },
+    { ID(0x12,0x00,0x00,0x00,0x00), ID(0x12,0x00,0x00,0x80,0x00), ANY, 7 },
+    { ID(0x0A,0x42,0x00,0x00,0x00), ID(0,0,0,0,0), 0x00F, 1, ORDER_RANDOM },
+    { ID(0x12,0x00,0x00,0x00,0x00), ID(0x12,0x00,0x00,0x80,0x00), ANY, 1,
+      ORDER_RANDOM },
+    { ID(0x0A,0x42,0x00,0x00,0x00), ID(0,0,0,0,0), 0x00F, 1, ORDER_GRAY },
+    /* random ranges with an end of one ID, none & 10 of them */
+    { ID(0x0A,0x42,0x00,0x00,0x05), ID(0x0A,0x42,0x00,0x00,0x06), 0x00F, 1,
+      ORDER_RANDOM },
+    { ID(0x0A,0x42,0x00,0x00,0x05), ID(0x0A,0x42,0x00,0x00,0x05), 0x00F, 1,
+      ORDER_RANDOM },
+    { ID(0x0A,0x42,0x00,0x00,0x30), ID(0x0A,0x42,0x00,0x00,0x3A), 0x00F, 1,
+      ORDER_RANDOM },
+    DICT,
+    };
+
+const uint8_t em_dict[] PROGMEM = {
+    0xB4, 0xA4, 0x80, 0x90, 0xA4, 0x01,
+    0x01,
+    0xBA, 0xD9, 0x02,
+    0xFF, 0x81, 0x81, 0xF6, 0x7B,
+    };
+#endif
+
+/* what frames.c works on, as in zigfrid.c without the registers */
+uint8_t em_bits[FRAME_SIZE * RING_FRAMES];
+uint8_t em_frame_id[RING_FRAMES][5];
+uint8_t em_id_list[RANGES * 5];
+uint8_t read_range;
+uint8_t read_offset_id;
+uint16_t dict_offset;
+uint8_t write_offset;
+uint8_t write_mask;
+struct {
+    uint8_t encoding;
+} profile;
+
+/* the ID write_id() writes, em_id_list[read_offset_id] but when timing the
+ * encoders */
+static const uint8_t *write_from;
+
+static uint8_t read_byte(uint8_t offset)
+{
+    return write_from[offset];
+}
+
+#include "frames.c"
+
+/* the encoders, & the 1st byte of the ID their frames carry */
+static const struct {
+    const char *name;
+    uint8_t encoding;
+} encoders[] = {
+#if PROTOCOL == PROTOCOL_EM41XX
+    { "manchester", ENCODING_MANCHESTER },
+    { "inverted", ENCODING_INVERTED },
+    { "alternate", ENCODING_ALTERNATE },
+    { "biphase", ENCODING_BIPHASE },
+#define ID_FROM             0
+#elif PROTOCOL == PROTOCOL_HID
+    { "hid", 0 },
+#if HID_FORMAT == 26
+#define ID_FROM             2
+#else
+#define ID_FROM             0
+#endif
+#else
+    { "indala", 0 },
+#define ID_FROM             1
+#endif
+    };
+#define ENCODERS            (sizeof(encoders) / sizeof(encoders[0]))
+
+/* IDs & the frames they make, EM41xx as its 64 bits, the others as the
+ * symbols of em_bits[] */
+#if PROTOCOL == PROTOCOL_EM41XX
+static const struct {
+    uint8_t id[5];
+    uint64_t bits;
+} golden[] = {
+    { ID(0x00,0x00,0x00,0x00,0x00), 0xFF80000000000000ULL },
+    { ID(0x0A,0x42,0x00,0x12,0x34), 0xFF82892800329930ULL },
+    { ID(0xFF,0xFF,0xFF,0xFF,0xFF), 0xFFFBDEF7BDEF7BC0ULL },
+    };
+#elif PROTOCOL == PROTOCOL_HID && HID_FORMAT == 26
+static const struct {
+    uint8_t id[5];
+    uint8_t bits[FRAME_SIZE];
+} golden[] = {
+    /* facility 1 card 1, 2006020002 */
+    { ID(0x00,0x00,0x01,0x00,0x01), { 0x1D, 0x55, 0x59, 0x55, 0x55, 0x69,
+                                      0x55, 0x59, 0x55, 0x55, 0x55, 0x59 } },
+    { ID(0x00,0x00,0x42,0x12,0x34), { 0x1D, 0x55, 0x59, 0x55, 0x55, 0x69,
+                                      0x95, 0x65, 0x59, 0x65, 0x69, 0x96 } },
+    };
+#elif PROTOCOL == PROTOCOL_HID
+static const struct {
+    uint8_t id[5];
+    uint8_t bits[FRAME_SIZE];
+} golden[] = {
+    { ID(0x20,0x06,0x02,0x00,0x02), { 0x1D, 0x55, 0x59, 0x55, 0x55, 0x69,
+                                      0x55, 0x59, 0x55, 0x55, 0x55, 0x59 } },
+    };
+#else
+static const struct {
+    uint8_t id[5];
+    uint8_t bits[FRAME_SIZE];
+} golden[] = {
+    /* a tag's raw frame as the proxmark dumps it, a0000000c2c436c1, both
+     * with the sync bit in the ID & without */
+    { ID(0x00,0xC2,0xC4,0x36,0xC1), { 0xA0, 0x00, 0x00, 0x00,
+                                      0xC2, 0xC4, 0x36, 0xC1 } },
+    { ID(0x00,0x42,0xC4,0x36,0xC1), { 0xA0, 0x00, 0x00, 0x00,
+                                      0xC2, 0xC4, 0x36, 0xC1 } },
+    };
+#endif
+#define GOLDEN              (sizeof(golden) / sizeof(golden[0]))
+
+/* the half bits of frame 'frame' in em_bits[] as the interrupt call sends
+ * them, 1 for a loaded coil: a set bit loads it on the 1st half. HID &
+ * Indala send a symbol per bit */
+static void air(uint8_t frame, uint8_t *h)
+{
+    for (int i = 0; i < FRAME_BITS; i++) {
+        uint8_t bit = em_bits[frame + i / 8] >> (7 - i % 8) & 1;
+#if PROTOCOL == PROTOCOL_EM41XX
+        h[i * 2] = bit;
+        h[i * 2 + 1] = !bit;
+#else
+        h[i] = bit;
+#endif
+    }
+}
+
+#if PROTOCOL == PROTOCOL_EM41XX
+#define HALVES              (FRAME_BITS * 2)
+
+/* decodes the EM41xx frame of the half bits from h[0] on, in manchester of
+ * the other polarity if 'inverted' or in biphase, whose 1st bit starts at
+ * h[-1]. fills in its 64 bits & ID, 0 if it's a valid frame */
+static int decode(const uint8_t *h, int biphase, int inverted, uint64_t *raw,
+                  uint8_t id[5])
+{
+    uint8_t bits[64], col = 0;
+    *raw = 0;
+    for (int i = 0; i < 64; i++) {
+        if (biphase) {
+            /* the load changes at the start of every bit, & in the middle
+             * of a zero */
+            if (h[i * 2 - 2] == h[i * 2 - 1]) {
+                return -1;
+            }
+            bits[i] = h[i * 2 - 1] == h[i * 2];
+        } else {
+            /* loaded coil on the 1st half is a zero */
+            if (h[i * 2] == h[i * 2 + 1]) {
+                return -1;
+            }
+            bits[i] = h[i * 2 + !inverted];
+        }
+        *raw = *raw << 1 | bits[i];
+    }
+    for (int i = 0; i < 9; i++) {
+        if (!bits[i]) {
+            return -2;
+        }
+    }
+    memset(id, 0, 5);
+    for (int r = 0; r < 10; r++) {
+        uint8_t n = 0, p = 0;
+        for (int c = 0; c < 5; c++) {
+            p ^= bits[9 + r * 5 + c];
+            n = c < 4 ? n << 1 | bits[9 + r * 5 + c] : n;
+        }
+        if (p) {
+            return -3;
+        }
+        col ^= n;
+        id[r / 2] |= r & 1 ? n : n << 4;
+    }
+    for (int c = 0; c < 4; c++) {
+        if (bits[59 + c] != (col >> (3 - c) & 1)) {
+            return -4;
+        }
+    }
+    return bits[63] ? -5 : 0;
+}
+#elif PROTOCOL == PROTOCOL_HID
+#define HALVES              FRAME_BITS
+
+/* decodes the HID frame of the symbols from h[0] on to its ID, 0 if it's a
+ * valid frame */
+static int decode(const uint8_t *h, uint8_t id[5])
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        if (h[i] != (HID_PREAMBLE >> (7 - i) & 1)) {
+            return -1;
+        }
+    }
+    /* a one is sent as 10 & a zero as 01, the 4 bits above the ID zeros */
+    for (int i = 0; i < 44; i++) {
+        if (h[8 + i * 2] == h[9 + i * 2]) {
+            return -2;
+        }
+        v = v << 1 | h[8 + i * 2];
+    }
+    if (v >> 40) {
+        return -3;
+    }
+#if HID_FORMAT == 26
+    /* H10301 after the 0x2004 header: even parity over the 12 high bits of
+     * facility & card, odd over the 12 low ones */
+    uint32_t w = v & 0x3FFFFFF;
+    if (v >> 26 != 0x2004000000ULL >> 26) {
+        return -4;
+    }
+    if (__builtin_parity(w >> 13) || !__builtin_parity(w & 0x1FFF)) {
+        return -5;
+    }
+    v = w >> 1 & 0xFFFFFF;
+#endif
+    for (int i = 0; i < 5; i++) {
+        id[i] = v >> (32 - 8 * i);
+    }
+    return 0;
+}
+#else
+#define HALVES              FRAME_BITS
+
+/* decodes the Indala frame of the bits from h[0] on to the last 4 bytes of
+ * its ID, 0 if it's a valid frame: the preamble 1010 & 28 zeros, then the
+ * ID starting with the sync one */
+static int decode(const uint8_t *h, uint8_t id[5])
+{
+    for (int i = 0; i < 33; i++) {
+        if (h[i] != (i == 0 || i == 2 || i == 32)) {
+            return -1;
+        }
+    }
+    memset(id, 0, 5);
+    for (int i = 0; i < 32; i++) {
+        id[1 + i / 8] |= h[32 + i] << (7 - i % 8);
+    }
+    return 0;
+}
+#endif
+
+static int verbose;
+
+/* the wildcard nibbles of 'id' in range 'r' as a number */
+static uint64_t get_wilds(const em_range_t *r, const uint8_t *id)
+{
+    uint64_t n = 0;
+    for (int i = 0; i < 10; i++) {
+        if (r->wild & (1 << (9 - i))) {
+            n = n << 4 | get_nibble(id, i);
+        }
+    }
+    return n;
+}
+
+/* the IDs range 'r' sends a sweep from its start, or 0 if they're too many
+ * to watch or a sweep doesn't start at the start again */
+static uint64_t sweep(const em_range_t *r, int nibbles)
+{
+    uint64_t first = get_wilds(r, r->start), size = 1ULL << (nibbles * 4);
+    int end = 0;
+    for (int i = 0; i < 5; i++) {
+        end |= r->end[i];
+    }
+    if (r->order == ORDER_DICT || (!end && r->order == ORDER_STRIDE &&
+                                   r->stride != 1)) {
+        return 0;
+    }
+    if (end && r->order != ORDER_GRAY) {
+        size = get_wilds(r, r->end) - first;
+        /* an empty range sends its start all the same */
+        size = size ? size : 1;
+    }
+    if (r->order == ORDER_STRIDE) {
+        size = (size + r->stride - 1) / r->stride;
+    }
+    return size <= 1 << 20 ? size : 0;
+}
+
+/* the fixed nibbles of 'id' as in range 'r', & its wildcards as a number */
+static int in_range(const em_range_t *r, const uint8_t *id, uint64_t *wild)
+{
+    uint64_t first = 0, last = 0, end = 0;
+    *wild = 0;
+    for (int i = 0; i < 10; i++) {
+        uint8_t n = get_nibble(id, i), s = get_nibble(r->start, i);
+        if (!(r->wild & (1 << (9 - i)))) {
+            if (n != s) {
+                return 0;
+            }
+            continue;
+        }
+        *wild = *wild << 4 | n;
+        first = first << 4 | s;
+        last = last << 4 | get_nibble(r->end, i);
+    }
+    for (int i = 0; i < 5; i++) {
+        end |= r->end[i];
+    }
+    /* stride & random go from the start to the end, gray all over, & an
+     * empty range stays at its start */
+    return !end || r->order == ORDER_GRAY ||
+           (*wild >= first && (*wild < last || *wild == first));
+}
+
+/* writes the current ID to frame 'frame' in em_bits[], or copies frame 'last'
+ * to it sending the same ID again, in the polarity after frame 'last' */
+static void fill(uint8_t frame, uint8_t last, int again)
+{
+    if (again) {
+        copy_em_id(frame, last);
+    } else {
+        write_id(frame);
+    }
+#if PROTOCOL == PROTOCOL_EM41XX
+    set_polarity(frame, last);
+#endif
+}
+
+/* decodes frame 'frame' in em_bits[], sent right after frame 'last' whose
+ * half bits are 'lh', to 'fh', 0 if it's a frame of 'id' in the polarity of
+ * encoder 'e' */
+static int check_frame(uint8_t e, uint8_t frame, uint8_t last, uint8_t *fh,
+                       const uint8_t *lh, const uint8_t *id, long n)
+{
+    uint8_t decoded[5] = { 0 };
+    int err;
+    air(frame, fh);
+    /* the half bits before the frame are the end of the last one */
+    fh[-1] = lh[HALVES - 1];
+    fh[-2] = lh[HALVES - 2];
+#if PROTOCOL == PROTOCOL_EM41XX
+    uint64_t raw;
+    int biphase = profile.encoding == ENCODING_BIPHASE, inverted = 0;
+    err = decode(fh, biphase, 0, &raw, decoded);
+    if (err && !biphase) {
+        inverted = 1;
+        err = decode(fh, 0, 1, &raw, decoded);
+    }
+    if (!err && ((profile.encoding == ENCODING_MANCHESTER && inverted) ||
+                 (profile.encoding == ENCODING_INVERTED && !inverted) ||
+                 (profile.encoding == ENCODING_ALTERNATE && n &&
+                  inverted == frame_flip(last)))) {
+        printf("FAIL: %s frame %ld in the wrong polarity\n",
+               encoders[e].name, n);
+        return 1;
+    }
+#else
+    /* the polarity is the same for all frames */
+    (void)last;
+    err = decode(fh, decoded);
+#endif
+    uint8_t want[5];
+    memcpy(want, id, 5);
+#if PROTOCOL == PROTOCOL_INDALA
+    /* the sync bit */
+    want[1] |= 0x80;
+#endif
+    if (err || memcmp(want + ID_FROM, decoded + ID_FROM, 5 - ID_FROM)) {
+        printf("FAIL: %s frame %ld of %02X%02X%02X%02X%02X decodes to "
+               "%02X%02X%02X%02X%02X (%d)\n", encoders[e].name, n,
+               id[0], id[1], id[2], id[3], id[4], decoded[0], decoded[1],
+               decoded[2], decoded[3], decoded[4], err);
+        return 1;
+    }
+    if (verbose && n < 8) {
+        printf("  %02X%02X%02X%02X%02X:", id[0], id[1], id[2], id[3], id[4]);
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            printf(" %02X", em_bits[frame + i]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+/* sends the IDs of range 'r' through encoder 'e' from its start, REPEAT
+ * frames each as the main loop does, decoding them & watching the order of
+ * the IDs, 0 if all was well */
+static int check(uint8_t r, uint8_t e, long ids)
+{
+    const em_range_t *range = &em_ranges[r];
+    uint8_t h[RING_FRAMES][HALVES + 2] = { { 0 } }, *frame_h[RING_FRAMES];
+    uint8_t id[5], prev[5] = { 0 }, *seen = NULL;
+    int nibbles = 0, failed = 0, over = 0;
+    uint64_t size, first, sent = 0;
+    long n = 0;
+    profile.encoding = encoders[e].encoding;
+    for (int i = 0; i < 10; i++) {
+        nibbles += range->wild >> i & 1;
+    }
+    /* gray runs over all of the wildcards, the others from their start */
+    size = sweep(range, nibbles);
+    first = range->order == ORDER_GRAY ? 0 : get_wilds(range, range->start);
+    if (size) {
+        seen = calloc(size, 1);
+    }
+    for (int f = 0; f < RING_FRAMES; f++) {
+        write_header(f * FRAME_SIZE);
+        clear_id(f * FRAME_SIZE);
+        frame_h[f] = &h[f][2];
+    }
+    uint8_t last = FRAME_SIZE * (RING_FRAMES - 1);
+    write_id(last);
+    air(last, frame_h[RING_FRAMES - 1]);
+
+    for (long k = 0; k < ids && !failed; k++) {
+        uint64_t wild = 0;
+        memcpy(id, write_from, 5);
+        for (int c = 0; c < REPEAT && !failed; c++, n++) {
+            uint8_t frame = (n % RING_FRAMES) * FRAME_SIZE;
+            fill(frame, last, c);
+            failed |= check_frame(e, frame, last, frame_h[frame / FRAME_SIZE],
+                                  frame_h[last / FRAME_SIZE], id, n);
+            last = frame;
+        }
+
+        /* the generator, whose IDs stay in the range, each once a sweep &
+         * the dictionary's sorted */
+        if (range->order == ORDER_DICT) {
+            if (k && !over && memcmp(id, prev, 5) <= 0) {
+                printf("FAIL: dictionary ID %ld not sorted\n", k);
+                failed = 1;
+            }
+        } else if (!in_range(range, id, &wild)) {
+            printf("FAIL: ID %ld %02X%02X%02X%02X%02X off its range\n", k,
+                   id[0], id[1], id[2], id[3], id[4]);
+            failed = 1;
+        } else if (seen) {
+            /* stride ranges step from their start, by their stride */
+            uint64_t i = wild - first;
+            if (range->order == ORDER_STRIDE) {
+                i /= range->stride;
+            }
+            if (i >= size || seen[i]++) {
+                printf("FAIL: ID %ld %02X%02X%02X%02X%02X twice in a "
+                       "sweep\n", k, id[0], id[1], id[2], id[3], id[4]);
+                failed = 1;
+            }
+            sent++;
+        }
+        memcpy(prev, id, 5);
+        over = inc_em_id();
+        if (over && seen && !failed) {
+            /* a whole sweep, so every ID once */
+            if (sent != size) {
+                printf("FAIL: ID %ld ends a sweep of %llu IDs out of %llu\n",
+                       k, (unsigned long long)sent, (unsigned long long)size);
+                failed = 1;
+            }
+            memset(seen, 0, size);
+            sent = 0;
+        }
+    }
+    free(seen);
+    return failed;
+}
+
+/* encodes the golden IDs with encoder 'e' to a fresh frame, 0 if they all
+ * make the frames of golden[] */
+static int check_golden(uint8_t e)
+{
+    uint8_t h[HALVES + 2] = { 0 }, decoded[5];
+    int failed = 0;
+    profile.encoding = encoders[e].encoding;
+    for (unsigned g = 0; g < GOLDEN; g++) {
+        write_from = golden[g].id;
+        write_header(0);
+        clear_id(0);
+        write_id(0);
+        air(0, &h[2]);
+#if PROTOCOL == PROTOCOL_EM41XX
+        uint64_t raw;
+        int biphase = profile.encoding == ENCODING_BIPHASE;
+        int inverted = !biphase && frame_flip(0);
+        /* the last bit before the frame, at the level the 1st one starts
+         * from in biphase */
+        h[0] = biphase && frame_flip(0);
+        h[1] = !h[0];
+        int err = decode(&h[2], biphase, inverted, &raw, decoded);
+        if (err || raw != golden[g].bits) {
+            printf("FAIL: %s golden frame %u is %016llX (%d)\n",
+                   encoders[e].name, g, (unsigned long long)raw, err);
+            failed = 1;
+        }
+#else
+        int err = decode(&h[2], decoded);
+        if (err || memcmp(&em_bits[0], golden[g].bits, FRAME_SIZE)) {
+            printf("FAIL: %s golden frame %u (%d):", encoders[e].name, g, err);
+            for (int i = 0; i < FRAME_SIZE; i++) {
+                printf(" %02X", em_bits[i]);
+            }
+            printf("\n");
+            failed = 1;
+        }
+#endif
+    }
+    return failed;
+}
+
+/* starts every range over & picks range 'r' */
+static void start(uint8_t r)
+{
+    load_em_ranges();
+    read_range = r;
+    read_offset_id = r * 5;
+    write_from = &em_id_list[read_offset_id];
+}
+
+/* the ticks of stepping range 'r' 'ids' times, or of writing the IDs of
+ * 'batch' to frames with encoder 'e' */
+static uint64_t run_once(uint8_t r, int e, long ids, const uint8_t *batch)
+{
+    start(r);
+    uint64_t t0;
+    if (e < 0) {
+        t0 = ticks();
+        for (long k = 0; k < ids; k++) {
+            inc_em_id();
+        }
+    } else {
+        profile.encoding = encoders[e].encoding;
+        for (int f = 0; f < RING_FRAMES; f++) {
+            write_header(f * FRAME_SIZE);
+            clear_id(f * FRAME_SIZE);
+        }
+        uint8_t last = 0;
+        t0 = ticks();
+        for (long k = 0; k < ids; k++) {
+            uint8_t frame = (k % RING_FRAMES) * FRAME_SIZE;
+            write_from = &batch[k * 5];
+            fill(frame, last, 0);
+            last = frame;
+        }
+    }
+    return ticks() - t0;
+}
+
+/* the fewest ticks of a few runs, the others having been interrupted */
+static uint64_t run(uint8_t r, int e, long ids, const uint8_t *batch)
+{
+    uint64_t best = ~0ULL;
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t t = run_once(r, e, ids, batch);
+        best = t < best ? t : best;
+    }
+    return best;
+}
+
+/* the name of the order of range 'r' */
+static const char *order(uint8_t r)
+{
+    static const char *names[] = { "stride", "random", "dict", "gray" };
+    uint8_t o = em_ranges[r].order;
+    return o < 4 ? names[o] : "?";
+}
+
+int main(int argc, char **argv)
+{
+    long ids = 1 << 17;
+    int opt, failed = 0;
+
+    while ((opt = getopt(argc, argv, "n:v")) != -1) {
+        switch (opt) {
+        case 'n': ids = atol(optarg); break;
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-n IDs] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (unsigned e = 0; e < ENCODERS; e++) {
+        failed |= check_golden(e);
+    }
+    for (uint8_t r = 0; r < RANGES; r++) {
+        for (unsigned e = 0; e < ENCODERS; e++) {
+            if (verbose) {
+                printf("range %u, %s:\n", r, encoders[e].name);
+            }
+            start(r);
+            failed |= check(r, e, ids);
+        }
+    }
+
+    printf("%ld IDs of each range, %s per ID\n", ids, TICKS);
+    printf("%-6s %-7s %10s", "range", "order", "inc_em_id");
+    for (unsigned e = 0; e < ENCODERS; e++) {
+        printf(" %10s", encoders[e].name);
+    }
+    printf("\n");
+    /* the encoders write the IDs the range steps through, made ahead */
+    uint8_t *batch = malloc(ids * 5);
+    for (uint8_t r = 0; r < RANGES; r++) {
+        start(r);
+        for (long k = 0; k < ids; k++) {
+            memcpy(&batch[k * 5], write_from, 5);
+            inc_em_id();
+        }
+        printf("%-6u %-7s %10.1f", r, order(r),
+               (double)run(r, -1, ids, NULL) / ids);
+        for (unsigned e = 0; e < ENCODERS; e++) {
+            printf(" %10.1f", (double)run(r, e, ids, batch) / ids);
+        }
+        printf("\n");
+    }
+    free(batch);
+    if (!failed) {
+        printf("all frames decode, golden frames match\n");
+    }
+    return failed;
+}
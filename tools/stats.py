@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+#
+# prints the counters of a -DSTATS build from a raw dump of its eeprom, as
+# make stats reads it: the frames sent, the IDs done, the power ups, the
+# frames lost to underruns & the main loop's worst latency at the start of a
+# frame. they're in the newest valid one of the two slots at the very end of
+# the eeprom (stats_t in zigfrid.c). --protocol & --rate add the time on air.
+#
+# usage: stats.py [--rate 64] [--protocol em|hid|indala] zigfrid-eeprom.bin
+
+import argparse
+import struct
+import sys
+
+# the bits per frame & carrier cycles per bit of each protocol, EM41xx's rate
+# being --rate, as in ids.py
+PROTOCOLS = {'em': (64, None), 'hid': (96, 50), 'indala': (64, 32)}
+CARRIER = 125000
+# stats_t: seq, frames, ids, boots, lost, latency, frame_size & crc
+STATS = struct.Struct('<BIIHHBBB')
+
+
+def crc8_ccitt(data):
+    """_crc8_ccitt_update() of avr-libc over 'data', from 0"""
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc << 1 ^ 0x07 if crc & 0x80 else crc << 1) & 0xFF
+    return crc
+
+
+def newest(eeprom):
+    """the fields of the newest valid slot, None if there's none"""
+    found = None
+    base = len(eeprom) - 2 * STATS.size
+    for slot in range(2):
+        raw = eeprom[base + slot * STATS.size:base + (slot + 1) * STATS.size]
+        if crc8_ccitt(raw[:-1]) != raw[-1]:
+            continue
+        s = STATS.unpack(raw)
+        # newer than the other one, sequence numbers wrapping?
+        if found and (s[0] - found[0] + 0x80) % 0x100 - 0x80 <= 0:
+            continue
+        found = s
+    return found
+
+
+def duration(seconds):
+    for unit, size in (('days', 86400), ('hours', 3600), ('minutes', 60)):
+        if seconds >= size * 2:
+            return '%.1f %s' % (seconds / size, unit)
+    return '%.1f seconds' % seconds
+
+
+def main():
+    ap = argparse.ArgumentParser(description='print the stats of zigfrid')
+    ap.add_argument('eeprom')
+    ap.add_argument('--rate', type=int, default=64, choices=(32, 64))
+    ap.add_argument('--protocol', default='em', choices=sorted(PROTOCOLS))
+    args = ap.parse_args()
+
+    s = newest(open(args.eeprom, 'rb').read())
+    if s is None:
+        sys.exit('no stats in %s, is it a -DSTATS build?' % args.eeprom)
+    _, frames, ids, boots, lost, latency, frame_size, _ = s
+
+    frame_bits, rate = PROTOCOLS[args.protocol]
+    rate = rate or args.rate
+    print('power ups:      %d' % boots)
+    print('frames sent:    %d, %s on air at RF/%d' %
+          (frames, duration(frames * frame_bits * rate / CARRIER), rate))
+    print('IDs done:       %d%s' %
+          (ids, ', %.1f frames each' % (frames / ids) if ids else ''))
+    print('frames lost:    %d%s' %
+          (lost, ', %.2f%%' % (100.0 * lost / frames) if frames else ''))
+    if latency >= frame_size:
+        print('worst latency:  a whole frame or more, frames were missed')
+    else:
+        print('worst latency:  %d of the %d bytes of a frame' %
+              (latency, frame_size))
+
+
+if __name__ == '__main__':
+    main()
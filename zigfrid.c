@@ -21,7 +21,16 @@
  * The interrupt call reads the buffer, xoring every odd offset with previous
  * bit due to the Manchester encoding, and sends the correct bit, all in less
  * than ~20 clock cycles, to allow the main procedure to increment the buffer
- * when needed.
+ * when needed. The bits are packed 8 to a byte and shifted out of a register,
+ * so a frame takes only 8 bytes of the precious SRAM.
+ *
+ * The buffer is a ring of frames back to back. While the interrupt call sends
+ * one of them the main procedure writes the next IDs into the others, so there
+ * is no gap on air when switching IDs.
+ *
+ * EM41xx is the default, HID Prox (FSK) & Indala (PSK) frames can be built in
+ * its place, see PROTOCOL. those have timer0 generate the subcarrier & the
+ * interrupt call only switch it once per bit.
  * 
  * Non critical parts are coded in C for easier hacking. The Assembly parts are
  * required for ensuring exact clock cycles and some needed optimizations.
@@ -36,232 +45,2194 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <util/crc16.h>
+#include <util/parity.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "frames.h"
 
 /*******************************************************************************
  *
- * list of EM41xs IDs to send, each ID is 5 bytes long.
+ * list of EM41xs ID ranges to send, each ID is 5 bytes long.
  * 1st byte = manufacture id, 4 bytes = card id.
- * each ID will be incremented.
  *
- * change as you like, as long as you retain the game rules.
+ * each range starts at 'start' and sends IDs up to, but not including, 'end'
+ * before starting over. an 'end' of all zeros means there's no end, the 
+ * wildcard nibbles just wrap around.
+ *
+ * 'wild' has a bit per nibble of the ID, bit 0 being its lowest nibble. only
+ * the wildcard nibbles vary, as if they were a number of their own which is
+ * incremented by 'stride' after each ID. the other nibbles stay as in 'start',
+ * and only the wildcard nibbles of 'end' count.
+ *
+ * 'order' ORDER_RANDOM ignores 'stride' & sends the range in pseudo random
+ * order instead, every ID of it once before starting over, so it doesn't 
+ * matter where in the range the valid IDs are.
+ *
+ * 'order' ORDER_GRAY ignores 'stride' & 'end', & walks all of the wildcard 
+ * nibbles in gray code from 'start' on, each ID a single bit off the one 
+ * before it. for EM41xx that's a single row to write to the frame & the 
+ * column parity, a switch of IDs takes the same time throughout the range
+ * instead of rewriting all rows whenever a carry ripples through them.
+ *
+ * the ranges take turns, 'weight' IDs each, one when it's left out, so the
+ * likelier ranges can get more of the time. a weight of DEPTH_FIRST sends 
+ * the range all through, until it starts over, before the next one's turn.
+ * for example:
+ *
+ *   facility 0x12, card numbers 0x0000 to 0x7FFF:
+ *      { ID(0x12,0x00,0x00,0x00,0x00), ID(0x12,0x00,0x00,0x80,0x00), ANY, 1 }
+ *   every 10th card of manufacturer 0x0A, facility byte 0x42:
+ *      { ID(0x0A,0x42,0x00,0x00,0x00), ID(0,0,0,0,0), 0x03F, 10 }
+ *   only the low nibbles of the 1st & last card bytes vary:
+ *      { ID(0x00,0x50,0x55,0x55,0x50), ID(0,0,0,0,0), 0x041, 1 }
+ *   the same card numbers of facility 0x12 in random order:
+ *      { ID(0x12,0x00,0x00,0x00,0x00), ID(0x12,0x00,0x00,0x80,0x00), ANY, 1,
+ *        ORDER_RANDOM }
+ *   facility 0x12 4 IDs per turn, 4 times as many as each of the others:
+ *      { ID(0x12,0x00,0x00,0x00,0x00), ID(0,0,0,0,0), 0x00F, 1,
+ *        ORDER_STRIDE, 4 }
+ *
+ * em_range_t & the ORDER_ values are in frames.h. change as you like, as long
+ * as you retain the game rules.
  *
  ******************************************************************************/
-uint8_t em_id_list[] = {
-                        0x00, 0x00, 0x00, 0x00, 0x00 ,
-                        0xFF, 0xFF, 0xFF, 0xFF, 0xFF ,
-                        0x11, 0x11, 0x11, 0x11, 0x11 ,
-                        0x22, 0x22, 0x22, 0x22, 0x22 ,
-                        0x33, 0x33, 0x33, 0x33, 0x33 ,
-                        0x44, 0x44, 0x44, 0x44, 0x44 ,
-                        0x55, 0x55, 0x55, 0x55, 0x55 ,
-                        0x66, 0x66, 0x66, 0x66, 0x66 ,
-                        0x77, 0x77, 0x77, 0x77, 0x77 ,
-                        0x88, 0x88, 0x88, 0x88, 0x88 ,
-                        0x99, 0x99, 0x99, 0x99, 0x99 ,
-                        0x12, 0x34, 0x56, 0x78, 0x9A 
-                        };
+#ifdef IDS_H
+/* em_ranges[] & em_dict[] generated by 'make ids IDS=file.txt' */
+#include IDS_H
+#else
+const em_range_t em_ranges[] PROGMEM = {
+    { ID(0x00,0x00,0x00,0x00,0x00), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0xFF,0xFF,0xFF,0xFF,0xFF), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x11,0x11,0x11,0x11,0x11), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x22,0x22,0x22,0x22,0x22), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x33,0x33,0x33,0x33,0x33), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x44,0x44,0x44,0x44,0x44), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x55,0x55,0x55,0x55,0x55), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x66,0x66,0x66,0x66,0x66), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x77,0x77,0x77,0x77,0x77), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x88,0x88,0x88,0x88,0x88), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x99,0x99,0x99,0x99,0x99), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    { ID(0x12,0x34,0x56,0x78,0x9A), ID(0x00,0x00,0x00,0x00,0x00), ANY, 1 },
+    };
+#endif
 
 /*******************************************************************************
  *
- * here begins the real code & logic. hack at your own risk.
+ * dictionary of IDs to send, for lists too long to fit em_ranges[] like dumps
+ * of known cards. a range of DICT in em_ranges[] sends them one after the 
+ * other, taking turns with the other ranges as usual, & starts over at the 
+ * end. only one range may be DICT.
+ *
+ * the IDs are sorted & each is stored as its difference to the one before it
+ * (the 1st one to zero), 7 bits per byte starting with the lowest ones, the 
+ * msb set on all but the last byte. IDs of the same facility are a byte or 
+ * two apart, so thousands of them fit the flash. for example:
+ *
+ *   0x0A42001234:   0xB4, 0xA4, 0x80, 0x90, 0xA4, 0x01,
+ *   0x0A42001235:   0x01,
+ *   0x0A4200BEEF:   0xBA, 0xD9, 0x02,
+ *   0x1200C0FFEE:   0xFF, 0x81, 0x81, 0xF6, 0x7B,
+ *
+ * 'make ids IDS=file.txt' generates both em_ranges[] & em_dict[] from a list
+ * instead, see tools/ids.py.
  *
  ******************************************************************************/
+#ifndef IDS_H
+const uint8_t em_dict[] PROGMEM = {
+    0xB4, 0xA4, 0x80, 0x90, 0xA4, 0x01,
+    0x01,
+    0xBA, 0xD9, 0x02,
+    0xFF, 0x81, 0x81, 0xF6, 0x7B,
+    };
+#endif
 
-/* number of times to resend ID before proceeding to next one */
-#define MAX_SEND_COUNTER        8 * 3
+/*******************************************************************************
+ *
+ * list of profiles, each sets how IDs are sent. PROFILE picks the one to use.
+ *
+ * repeat is the number of frames sent per ID before proceeding to the next
+ * one. most readers decode an ID after 2-3 frames, some debounce & want more.
+ * a frame is 64 bits of DATA_RATE carrier cycles, at 125khz that's 30.5 frames
+ * per second at RF/64 (61 at RF/32 & with Indala, 26 with HID's 96 bits of 
+ * RF/50), so the IDs per second are:
+ *
+ *      repeat      RF/64       RF/32
+ *        2         15.3        30.5
+ *        3         10.2        20.3
+ *        4          7.6        15.3
+ *        8          3.8         7.6
+ *       24          1.3         2.5
+ *
+ * encoding is how EM41xx bits are sent, ENCODING_MANCHESTER when left out:
+ *
+ *   ENCODING_MANCHESTER    a zero loads the coil on the 1st half of the bit
+ *   ENCODING_INVERTED      a zero loads it on the 2nd half, the other polarity
+ *   ENCODING_ALTERNATE     both polarities, a frame each, for readers of either
+ *                          on site. a reader only decodes every other frame 
+ *                          then, so repeat should be twice as much.
+ *   ENCODING_BIPHASE       the load changes at the start of every bit, & in 
+ *                          the middle of a zero
+ *
+ * all of them are written to em_bits[] by the main loop, the interrupt call 
+ * sends them the same way.
+ *
+ * rate is the EM41xx data rate, 64 or 32, DATA_RATE when left out. only the 
+ * USI engine switches it, the timer interrupt can't keep up with RF/32.
+ *
+ * first_range & ranges pick the ranges of em_ranges[] to send, 'ranges' of 
+ * them from 'first_range' on, all of them from there when left out. so a 
+ * profile can stick to a facility, or send the dictionary only.
+ *
+ ******************************************************************************/
+typedef struct {
+    uint8_t repeat;
+    uint8_t encoding;
+    uint8_t rate;
+    uint8_t first_range;
+    uint8_t ranges;
+} profile_t;
+
+const profile_t profiles[] PROGMEM = {
+                        { 3 },      /* EM41xx door readers, fast decode */
+                        { 4 },      /* readers which want 2 equal frames */
+                        { 8 },      /* debouncing readers, slow to wake */
+                        { 24 },     /* the original, for the difficult ones */
+                        { 6, ENCODING_ALTERNATE },  /* either polarity */
+                        { 3, ENCODING_BIPHASE },    /* biphase EM readers */
+                        { 3, ENCODING_MANCHESTER, 32 },     /* RF/32, USI */
+                        { 3, ENCODING_MANCHESTER, 0, 0, 1 },/* 1st range */
+                        };
+
+#ifndef PROFILE
+#define PROFILE                 0
+#endif
+
+/* define STRAPS to pick profile PROFILE + n at power up instead, n being read
+ * off the strap pins tied to ground: PB1 for bit 0 & PB2 for bit 1, so 4 
+ * profiles without reflashing. define STRAP_RESET too for PB5 as bit 2, once
+ * the RSTDISBL fuse made it an I/O pin, for 8 (the fuse takes a high voltage
+ * programmer to undo). HID, Indala & OUTPUT_USI send on PB1, which leaves PB2
+ * as bit 0 & PB5 as bit 1. past the end of profiles[] it's PROFILE again. */
+//#define STRAPS
+//#define STRAP_RESET
 
-/* send manchester bit every xx cycles (inclusive) */
-#define MAX_TIMER0              31
+/*******************************************************************************
+ *
+ * here begins the real code & logic. hack at your own risk.
+ *
+ ******************************************************************************/
 
 /* pins to enable/disable for rf */
 #define OUT_PINS                _BV(PINB3) | _BV(PINB4)
 
-/* get nibbles of a byte */
-#define NIBBLE_HIGH(x)          (x >> 4)
-#define NIBBLE_LOW(x)           (x & 0x0F)
+/* the protocol to send, e.g. make DEFS=-DPROTOCOL=PROTOCOL_HID. EM41xx is sent
+ * by toggling OUT_PINS from the timer0 interrupt. HID & Indala modulate a 
+ * subcarrier too fast for that at our 125khz, so timer0 generates it on OC0B 
+ * (PB1) in hardware and timer1 interrupts once per bit to switch it. like
+ * OUTPUT_USI, PB1 needs a transistor (or similar) across the coil.
+ *
+ * HID Prox sends 96 bits of RF/50 in FSK, fc/10 for a one & fc/8 for a zero: a
+ * preamble & then 44 bits manchester encoded. with HID_FORMAT 26 the 3rd byte
+ * of the ID is the facility code & the last two the card number (as the 
+ * 'facility/card' lines of tools/ids.py), sent as a H10301 26 bit card with 
+ * its parity. with HID_FORMAT 0 the ID is sent as is, for the other formats,
+ * e.g. 2004xxxxxx as readers & the proxmark show 26 bit cards.
+ *
+ * Indala sends 64 bits of RF/32 in PSK1 on a fc/2 subcarrier, whose phase 
+ * flips whenever the bit changes: the preamble 0xA0000000, then the last 4 
+ * bytes of the ID as they're read off a tag (the card number is scrambled in
+ * there, so these are best sent from the dictionary), e.g. a0000000c2c436c1
+ * raw. their 1st bit is the sync one after the preamble, always sent set.
+ *
+ * PROTOCOL_EM41XX is the default, the values & HID_FORMAT's 26 are in
+ * frames.h. */
+#if PROTOCOL != PROTOCOL_EM41XX
+#ifdef DATA_RATE
+#error "DATA_RATE is EM41xx only"
+#endif
+#if PROTOCOL == PROTOCOL_HID
+#define DATA_RATE               50
+#elif PROTOCOL == PROTOCOL_INDALA
+#define DATA_RATE               32
+#else
+#error "unknown PROTOCOL"
+#endif
+#endif
+
+/* define OUTPUT_USI to have the USI shift the manchester bits out on its DO
+ * pin (PB1) instead of toggling OUT_PINS on every timer0 interrupt. the USI is
+ * clocked by timer0 compare match and interrupts only once per 8 half bits, 
+ * leaving most of the cycles to the main loop. DO drives high while the coil 
+ * should be loaded, so it needs a transistor (or similar) across the coil. 
+ * DI (PB0) is driven by the interrupt call too, so there's no led on it. */
+//#define OUTPUT_USI
+
+/* EM41xx data rate, carrier cycles per bit. most readers want 64 (RF/64), many
+ * accept 32 as well which sends twice the IDs per second, but only the USI
+ * keeps up with it. 16 isn't supported: USIDR would have to be reloaded within
+ * the 8 cycles of a half bit, and the interrupt response alone may take that.
+ * define RATE_PROBE (with OUTPUT_USI) to find out what a reader accepts: the 
+ * rate alternates between the two every PROBE_FRAMES frames, starting with 
+ * DATA_RATE while the led on PROBE_PIN is on, so watch which one the reader 
+ * beeps at. */
+#ifndef DATA_RATE
+#define DATA_RATE               64
+#endif
+//#define RATE_PROBE
+#define PROBE_FRAMES            128
+#ifndef PROBE_PIN
+#define PROBE_PIN               PINB2
+#endif
+
+#if PROTOCOL == PROTOCOL_EM41XX
+#if DATA_RATE != 64 && DATA_RATE != 32
+#error "DATA_RATE must be 64 or 32"
+#endif
+#if (DATA_RATE != 64 || defined(RATE_PROBE)) && !defined(OUTPUT_USI)
+#error "only OUTPUT_USI keeps up with RF/32"
+#endif
+#elif defined(RATE_PROBE)
+#error "RATE_PROBE is EM41xx only"
+#endif
+
+/* save the position in em_ranges[] to eeprom every CHECKPOINT_IDS IDs, so a
+ * power cycle resumes instead of starting over. the saves go round robin over
+ * the whole eeprom to spread the wear, 0 disables them. */
+#ifndef CHECKPOINT_IDS
+#define CHECKPOINT_IDS          64
+#endif
+
+/* define FAST_BOOT to have a frame on air right after power up, before the 
+ * ranges are loaded & the 1st ID is encoded, for readers which drop the field
+ * again quickly. the boot frame is encoded at compile time from BOOT_ID and 
+ * sent until the 1st ID of the ranges takes over. to keep the startup code 
+ * short the globals aren't cleared either, so they all have to be set in code.
+ * from reset to the 1st half bit it's the few cycles of the avr-libc startup,
+ * the copy of both frames from flash & setting up the timer, which counting
+ * instructions estimates at about 350 cycles (not measured), instead of the
+ * many thousands of encoding a frame. */
+//#define FAST_BOOT
+#define BOOT_ID                 0x00, 0x00, 0x00, 0x00, 0x00
+
+#if PROTOCOL != PROTOCOL_EM41XX && (defined(OUTPUT_USI) || defined(FAST_BOOT))
+#error "OUTPUT_USI & FAST_BOOT are EM41xx only"
+#endif
+
+/* the strap pins of STRAPS, lowest bit first, all but those sending */
+#if PROTOCOL != PROTOCOL_EM41XX || defined(OUTPUT_USI)
+#define STRAP_SEND              0
+#else
+#define STRAP_SEND              _BV(PINB1)
+#endif
+#ifdef STRAP_RESET
+#define STRAP_PINS              (STRAP_SEND | _BV(PINB2) | _BV(PINB5))
+#else
+#define STRAP_PINS              (STRAP_SEND | _BV(PINB2))
+#endif
+
+/* define HIT_SENSE to watch for the reader accepting an ID on HIT_PIN, wired 
+ * to its led, beeper or relay line, or to an opto on the door strike. the pin
+ * is pulled up & any change of it is a hit, low or high, its pin change flag
+ * latching it even when it's shorter than a loop of ours. on a hit the last 
+ * HIT_IDS IDs which went on air are saved at the end of the eeprom, since the
+ * reader accepts a few frames late, & then HIT_MODE:
+ *
+ *   HIT_HALT       stops sending, with the led on, until the next power up
+ *   HIT_REPLAY     sends those IDs only, over & over, to confirm the hit
+ *   HIT_BISECT     finds out which of them it was: rounds of HIT_ROUND frames
+ *                  send half of the candidates, a hit keeps that half & none
+ *                  the other, until the last one is confirmed by a hit of its
+ *                  own (or it starts over with all of them). so 8 IDs take 4
+ *                  rounds. each round follows HIT_QUIET frames of silence, 
+ *                  for the reader to let go of its led & forget the last ID.
+ *                  the winner goes to the replay slot & is sent from then on
+ *
+ * the record is a count of the hits so far, the count of IDs in it & the IDs,
+ * newest first, then a byte which is 0 once the replay slot holds a winner & 
+ * the slot (avrdude -U eeprom:r:hit.hex:i reads it). the checkpoints get the
+ * rest of the eeprom. define REPLAY_WINNER to send the replay slot's ID only,
+ * when there's one, instead of the ranges, like a clone of the card. */
+//#define HIT_SENSE
+//#define REPLAY_WINNER
+#ifndef HIT_PIN
+#define HIT_PIN                 PINB2
+#endif
+#ifndef HIT_IDS
+#define HIT_IDS                 8
+#endif
+#define HIT_HALT                0
+#define HIT_REPLAY              1
+#define HIT_BISECT              2
+#ifndef HIT_MODE
+#define HIT_MODE                HIT_HALT
+#endif
+#ifndef HIT_ROUND
+#define HIT_ROUND               128
+#endif
+#ifndef HIT_QUIET
+#define HIT_QUIET               64
+#endif
+
+#ifdef HIT_SENSE
+#if defined(STRAPS) && (STRAP_PINS & _BV(HIT_PIN))
+#error "HIT_PIN is a strap pin, e.g. -DHIT_PIN=PINB5 with RSTDISBL"
+#endif
+#if HIT_PIN == PINB0 || HIT_PIN == PINB3 || HIT_PIN == PINB4 || \
+    (HIT_PIN == PINB1 && STRAP_SEND == 0)
+#error "HIT_PIN is the led or sends"
+#endif
+#if HIT_MODE != HIT_HALT && HIT_MODE != HIT_REPLAY && HIT_MODE != HIT_BISECT
+#error "unknown HIT_MODE"
+#endif
+#if HIT_ROUND > 255 || HIT_QUIET > 255 || !HIT_ROUND || !HIT_QUIET
+#error "HIT_ROUND & HIT_QUIET must be 1 to 255 frames"
+#endif
+#elif defined(REPLAY_WINNER)
+#error "REPLAY_WINNER needs HIT_SENSE"
+#endif
+
+/* define BURST for readers which lock out after too many bad reads: bursts of
+ * BURST_IDS IDs, each followed by a pause of BURST_PAUSE frames with the coil
+ * let go, as if the card had left the field. define BURST_PIN as well to
+ * watch the reader's lockout led or beeper on it, pulled up like HIT_PIN: a
+ * change of it during a burst cuts the burst short, the IDs of it are sent
+ * again after the pause, & the pause doubles, up to BURST_BACKOFF times. each
+ * burst without a lockout halves it again, so it settles at the shortest
+ * pause the reader lets go with. the frames filled while pausing are left as
+ * they are & the interrupt call goes on sending them, quiet, so the pause
+ * starts & ends at a frame's start, give or take the main loop's latency.
+ * bursts only run while sweeping, a hit ends them. */
+//#define BURST
+//#define BURST_PIN               PINB2
+#ifndef BURST_IDS
+#define BURST_IDS               16
+#endif
+#ifndef BURST_PAUSE
+#define BURST_PAUSE             300
+#endif
+#ifndef BURST_BACKOFF
+#define BURST_BACKOFF           4
+#endif
+
+#ifdef BURST
+#if !BURST_IDS || BURST_IDS > 255 || !BURST_PAUSE || \
+    (BURST_PAUSE << BURST_BACKOFF) > 0xFFFF
+#error "BURST_IDS must be 1 to 255 & BURST_PAUSE, backed off, up to 65535"
+#endif
+#ifdef BURST_PIN
+#if defined(HIT_SENSE)
+#error "BURST_PIN & HIT_SENSE share the pin change flag"
+#endif
+#if defined(STRAPS) && (STRAP_PINS & _BV(BURST_PIN))
+#error "BURST_PIN is a strap pin"
+#endif
+#if BURST_PIN == PINB0 || BURST_PIN == PINB3 || BURST_PIN == PINB4 || \
+    (BURST_PIN == PINB1 && STRAP_SEND == 0)
+#error "BURST_PIN is the led or sends"
+#endif
+#endif
+#elif defined(BURST_PIN)
+#error "BURST_PIN needs BURST"
+#endif
+
+#ifdef RATE_PROBE
+#if PROBE_PIN == PINB0 || PROBE_PIN == PINB1 || PROBE_PIN == PINB3 || \
+    PROBE_PIN == PINB4
+#error "PROBE_PIN is DI or sends"
+#endif
+#if (defined(STRAPS) && (STRAP_PINS & _BV(PROBE_PIN))) || \
+    (defined(HIT_SENSE) && PROBE_PIN == HIT_PIN) || \
+    (defined(BURST_PIN) && PROBE_PIN == BURST_PIN)
+#error "PROBE_PIN is a strap, HIT_PIN or BURST_PIN, e.g. -DPROBE_PIN=PINB5"
+#endif
+#endif
+
+/* define MUTATE to send broken EM41xx frames among the good ones, for the 
+ * reader's parser: each frame filled is mutated with a chance of MUTATE_CHANCE
+ * in 256, by one of mutations[] picked at random, from a generator seeded 
+ * with MUTATE_SEED, so a session is the same every time. a mutation flips
+ * 'bits' bits of the frame from bit 'bit' (0 being the 1st one of the 
+ * header & 63 the stop bit), after it's encoded, so the interrupt call sends
+ * it as usual. the ID stays as it is & goes on in its next frames. the 1st
+ * bit of the header tells the polarity of the frame, it can't be mutated,
+ * & biphase profiles aren't, their bits depend on those before them. */
+//#define MUTATE
+#ifndef MUTATE_CHANCE
+#define MUTATE_CHANCE           64
+#endif
+#ifndef MUTATE_SEED
+#define MUTATE_SEED             0xACE1
+#endif
+
+#ifdef MUTATE
+#if PROTOCOL != PROTOCOL_EM41XX
+#error "MUTATE is EM41xx only"
+#endif
+#if MUTATE_CHANCE < 1 || MUTATE_CHANCE > 256 || !(MUTATE_SEED & 0xFFFF)
+#error "MUTATE_CHANCE must be 1 to 256 & MUTATE_SEED not 0"
+#endif
+
+typedef struct {
+    uint8_t bit;
+    uint8_t bits;
+} mutation_t;
+
+const mutation_t mutations[] PROGMEM = {
+    {  8, 1 },          /* a header of 8 ones */
+    {  5, 4 },          /* of 5 ones, the 1st one & 4 after a gap */
+    { 13, 1 },          /* the row parity of the 1st row */
+    { 58, 1 },          /* & of the last one */
+    { 59, 1 },          /* a column parity bit */
+    {  9, 1 },          /* a data bit, its row & column parity wrong */
+    { 63, 1 },          /* the stop bit, running into the next header */
+    { 59, 5 },          /* all of the column parity & the stop bit */
+    };
+
+#define MUTATIONS               (sizeof(mutations) / sizeof(mutation_t))
+#define UNMUTATED               0xFF
+#endif
+
+/* define TRACE to send a record out of TRACE_PIN whenever another ID goes on
+ * air, to line it up with the reader's logs: 0xA5, the frames sent so far (16
+ * bits, the low byte 1st), the ID & the profile, in 8N1 serial. a bit lasts 
+ * TRACE_TICKS ticks: timer0 compare matches for EM41xx (half bits) & timer1's
+ * for HID & Indala (bits), so it's 125000 / (TRACE_TICKS * DATA_RATE / 2) baud
+ * for EM41xx, 976 at RF/64, & 125000 / (TRACE_TICKS * DATA_RATE) otherwise.
+ *
+ * the bytes are only sent from the main loop when it's idle, & only when they
+ * end before the frame on air does, so a trace never holds back the next 
+ * frame, it just takes the idle cycles. a new ID while a record is still out
+ * is traced once it's done, the frame count tells what was skipped. the timer
+ * interrupt call rewrites all of DDRB, so with the timer engine it sends the
+ * pin in DDRB too, taking a cycle more per call: the pin is open drain then,
+ * pulled low for a zero, & wants a pull-up (most serial adapters have one). 
+ * PB0 by default, in place of the led, which OUTPUT_USI needs as DI. without
+ * TRACE none of it is built. */
+//#define TRACE
+#ifndef TRACE_PIN
+#define TRACE_PIN               PINB0
+#endif
+#ifndef TRACE_TICKS
+#define TRACE_TICKS             4
+#endif
+
+#ifdef TRACE
+#if TRACE_TICKS < 4 || (TRACE_TICKS & (TRACE_TICKS - 1))
+#error "TRACE_TICKS must be a power of 2 from 4 on"
+#endif
+#if TRACE_PIN == PINB3 || TRACE_PIN == PINB4 || \
+    (TRACE_PIN == PINB1 && STRAP_SEND == 0)
+#error "TRACE_PIN sends"
+#endif
+#if (defined(STRAPS) && (STRAP_PINS & _BV(TRACE_PIN))) || \
+    (defined(HIT_SENSE) && TRACE_PIN == HIT_PIN)
+#error "TRACE_PIN is a strap or HIT_PIN"
+#endif
+#if defined(BURST_PIN) && TRACE_PIN == BURST_PIN
+#error "TRACE_PIN is BURST_PIN"
+#endif
+#if defined(OUTPUT_USI) && TRACE_PIN == PINB0
+#error "OUTPUT_USI drives DI (PB0), TRACE_PIN has to go elsewhere"
+#endif
+#if defined(RATE_PROBE) && TRACE_PIN == PROBE_PIN
+#error "TRACE_PIN is PROBE_PIN"
+#endif
+#endif
+
+/* define STATS to count the frames sent, the IDs done, the power ups, the
+ * frames lost to underruns & the main loop's worst latency at the start of a
+ * frame, and save them with each checkpoint to two slots at the end of the
+ * eeprom, for make stats to read back. the slots aren't spread over the
+ * eeprom like checkpoints are, so it's meant for tuning runs. */
+//#define STATS
+
+#if defined(STATS) && !CHECKPOINT_IDS
+#error "STATS are saved with the checkpoints, CHECKPOINT_IDS can't be 0"
+#endif
+
+/* send manchester half bit every xx cycles (inclusive) */
+#define MAX_TIMER0              (DATA_RATE / 2 - 1)
+
+/* timer0 TOP of the HID subcarrier, fc/8 for a zero & fc/10 for a one, and 
+ * its duty cycle for both */
+#define FSK_TOP0                (8 - 1)
+#define FSK_TOP1                (10 - 1)
+#define FSK_DUTY                (4 - 1)
+
+/* number of frames in em_bits[], which the main loop fills ahead of the ones
+ * on air. more let slow ranges (random order, dictionaries) catch up within a
+ * few frames, at 13 bytes of RAM each (17 with HID). a power of 2, up to 8. */
+#ifndef RING_FRAMES
+#define RING_FRAMES             2
+#endif
+#if RING_FRAMES & (RING_FRAMES - 1) || RING_FRAMES < 2 || RING_FRAMES > 8
+#error "RING_FRAMES must be 2, 4 or 8"
+#endif
+
+/* uninitialized globals, not cleared at startup with FAST_BOOT */
+#ifdef FAST_BOOT
+#define NOINIT                  __attribute__ ((section(".noinit")))
+#else
+#define NOINIT
+#endif
+
+/* em_bits[] is aligned to twice its size when that's a power of 2, HID's 12 
+ * byte frames aren't */
+#if FRAME_SIZE & (FRAME_SIZE - 1)
+#define RING_ALIGN              1
+#else
+#define RING_ALIGN              (FRAME_SIZE * RING_FRAMES * 2)
+#endif
+
+/* the array which stores the bits to send, msb first. a set bit means OUT_PINS
+ * are enabled on the 1st half of the manchester bit, which is how a zero is
+ * sent (with HID & Indala it's a one). we're not initalizing it with the 
+ * EM41xx header & footer but doing this in code instead since it uses less 
+ * space. it holds RING_FRAMES frames which the interrupt call reads one after
+ * the other, wrapping back to the 1st one by clearing a single bit of its 
+ * pointer - hence the alignment - or with HID by comparing it to the end. */
+uint8_t em_bits[FRAME_SIZE * RING_FRAMES] 
+    __attribute__ ((aligned(RING_ALIGN))) NOINIT;
+
+#ifdef FAST_BOOT
+/* a whole frame in em_bits[] format of the ID 'a' to 'e', for the compiler to
+ * work out. these are the same rows as in em_rows[] (frames.c) & their column
+ * parity. */
+#define PARITY4(n)              (((n) ^ (n) >> 1 ^ (n) >> 2 ^ (n) >> 3) & 1)
+#define ROW64(n, i)             ((uint64_t)(((n) & 0x0F) << 1 | \
+                                 PARITY4((n) & 0x0F)) << (50 - 5 * (i)))
+#define BYTE64(x, i)            (ROW64((x) >> 4, i) | ROW64(x, (i) + 1))
+#define COLUMN64(x)             ((uint64_t)(((x) >> 4 ^ (x)) & 0x0F) << 1)
+#define FRAME64(a, b, c, d, e)  (~(0x1FFULL << 55 | \
+                                 BYTE64(a, 0) | BYTE64(b, 2) | BYTE64(c, 4) | \
+                                 BYTE64(d, 6) | BYTE64(e, 8) | \
+                                 COLUMN64((a) ^ (b) ^ (c) ^ (d) ^ (e))))
+#define FRAME_BYTE(f, i)        ((uint8_t)((f) >> (56 - 8 * (i))))
+#define FRAME(a, b, c, d, e)    { \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 0), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 1), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 2), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 3), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 4), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 5), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 6), \
+        FRAME_BYTE(FRAME64(a, b, c, d, e), 7) }
+#define BOOT_FRAME(id)          FRAME(id)
+
+/* the frame sent at power up & its ID */
+const uint8_t boot_frame[FRAME_SIZE] PROGMEM = BOOT_FRAME(BOOT_ID);
+const uint8_t boot_id[5] PROGMEM = { BOOT_ID };
+#endif
+
+/* the ID written in each frame of em_bits[], so only the nibbles which changed
+ * since have to be written again & the hit log knows which ID is on air */
+uint8_t em_frame_id[RING_FRAMES][5] NOINIT;
+
+#ifdef MUTATE
+/* the mutation of each frame of em_bits[], UNMUTATED if none, to undo it 
+ * before the frame is filled again, & the state of the dice */
+uint8_t frame_mutation[RING_FRAMES] NOINIT;
+uint16_t mutate_state NOINIT;
+#endif
+
+/* the current ID of each range in em_ranges[] */
+uint8_t em_id_list[RANGES * 5] NOINIT;
+_Static_assert(RANGES <= MAX_RANGES, "too many ranges in em_ranges[]");
+
+/* the range of the current ID, em_id_list[read_offset_id], & the IDs it sent
+ * so far in its turn */
+uint8_t read_range NOINIT;
+uint8_t read_count NOINIT;
+
+/* the profile in use, copied from profiles[] */
+profile_t profile NOINIT;
+
+/* offset in em_dict[] of the ID after the current one of the DICT range */
+uint16_t dict_offset NOINIT;
+
+#ifdef STATS
+/* the counters, saved to the two slots at the very end of the eeprom in turn,
+ * 'seq' telling the newest one & 'crc' covering the rest. 'latency' is in
+ * bytes of em_bits[] into a frame, up to 'frame_size' when it missed one */
+typedef struct {
+    uint8_t seq;
+    uint32_t frames;
+    uint32_t ids;
+    uint16_t boots;
+    uint16_t lost;
+    uint8_t latency;
+    uint8_t frame_size;
+    uint8_t crc;
+} stats_t;
+
+#define STATS_EEPROM            (E2END + 1 - 2 * sizeof(stats_t))
+
+/* the counters, the copy of them being written a byte at a time, the next
+ * byte of it or sizeof(stats_t) when there's nothing to write, its slot & the
+ * IDs since the last copy */
+stats_t stats NOINIT;
+stats_t stats_out NOINIT;
+uint8_t stats_offset NOINIT;
+uint8_t stats_slot NOINIT;
+uint8_t stats_counter NOINIT;
+#else
+#define STATS_EEPROM            (E2END + 1)
+#endif
+
+#ifdef BURST
+/* the IDs done of the burst, the frames left to fill of the pause, the
+ * doublings of it, the frames of em_bits[] filled while pausing, a bit each,
+ * & whether the coil is let go for them */
+uint8_t burst_count NOINIT;
+uint16_t burst_frames NOINIT;
+uint8_t burst_backoff NOINIT;
+uint8_t burst_quiet NOINIT;
+uint8_t burst_muted NOINIT;
+#define BURST_MUTED             burst_muted
+#ifdef BURST_PIN
+/* the position at the start of the burst, to send it again after a lockout */
+uint8_t burst_ids[RANGES * 5] NOINIT;
+uint8_t burst_range NOINIT;
+uint16_t burst_dict NOINIT;
+#endif
+#else
+#define BURST_MUTED             0
+#endif
+
+#ifdef HIT_SENSE
+/* what's done about hits, hit_state being one of */
+#define HIT_SWEEPING            0   /* none yet, watching */
+#define HIT_REPLAYING           1   /* sending hit_ids[], not watching */
+#define HIT_QUIET_ROUND         2   /* silent before a bisect round */
+#define HIT_ROUND_ON            3   /* in the round, watching */
+
+/* the last HIT_IDS IDs on air, 'hit_count' of them & hit_ids[hit_newest] 
+ * being the newest one. once replaying they're sorted oldest first & just 
+ * those from hit_low, 'hit_size' of them, are sent, hit_ids[hit_offset] being
+ * the next one. bisecting, the candidates left are the 'cand_size' from 
+ * 'cand_low' & hit_frames counts down the frames of the quiet or the round */
+uint8_t hit_ids[HIT_IDS][5] NOINIT;
+uint8_t hit_newest NOINIT;
+uint8_t hit_count NOINIT;
+uint8_t hit_state NOINIT;
+uint8_t hit_offset NOINIT;
+uint8_t hit_low NOINIT;
+uint8_t hit_size NOINIT;
+#if HIT_MODE == HIT_BISECT
+uint8_t hit_frames NOINIT;
+uint8_t cand_low NOINIT;
+uint8_t cand_size NOINIT;
+#endif
+
+/* the hit record at the end of the eeprom, before the stats if any, the IDs
+ * newest first, and the replay slot, 'winner' being 0 once it's set */
+typedef struct {
+    uint8_t hits;
+    uint8_t count;
+    uint8_t ids[HIT_IDS][5];
+    uint8_t winner;
+    uint8_t replay[5];
+} hit_t;
 
-/* the array which stores the bits (0/1) to send. we're not initalizing it with 
- * the EM41xx header & footer but doing this in code instead since it uses
- * less space. */
-uint8_t em_bits[64];
+#define HIT_EEPROM              (STATS_EEPROM - sizeof(hit_t))
+#else
+#define HIT_EEPROM              STATS_EEPROM
+#endif
+
+#ifdef TRACE
+/* the record being sent, trace_next being its next byte or past its end once
+ * it's out. the ID on air, whether it still wants a record, the frames on air
+ * so far & the profile in use, for the record */
+uint8_t trace_record[9] NOINIT;
+uint8_t trace_next NOINIT;
+uint8_t trace_id[5] NOINIT;
+uint8_t trace_due NOINIT;
+uint16_t trace_frames NOINIT;
+uint8_t profile_index NOINIT;
+#endif
+
+#if CHECKPOINT_IDS
+/* a saved position, where 'seq' tells the newest one & 'crc' covers the rest
+ * along with em_ranges[] itself & the size of em_dict[], so a changed list 
+ * doesn't resume */
+typedef struct {
+    uint8_t seq;
+    uint8_t range;
+    uint16_t dict;
+    uint8_t ids[RANGES * 5];
+    uint8_t crc;
+} checkpoint_t;
+
+/* number of checkpoints fitting in the eeprom, before the hit record & the
+ * stats */
+#define CHECKPOINT_SLOTS        (HIT_EEPROM / sizeof(checkpoint_t))
+
+/* the checkpoint being written a byte at a time, 'checkpoint_offset' being 
+ * the next byte of it or sizeof(checkpoint_t) when there's nothing to write */
+checkpoint_t checkpoint NOINIT;
+uint8_t checkpoint_offset NOINIT;
+uint8_t checkpoint_slot NOINIT;
+uint8_t checkpoint_crc NOINIT;
+uint8_t checkpoint_counter NOINIT;
+
+/* crc of em_ranges[] & the size of em_dict[], which starts the crc of each
+ * checkpoint */
+uint8_t ranges_crc NOINIT;
+#endif
 
 /* using registers for global offsets & counters */
+#ifdef OUTPUT_USI
+volatile register uint8_t usi_next          __asm__("r3") ;
+/* the byte after usi_next & PB0's bit of PINB when its 1st half bit isn't 
+ * usi_next's, to toggle DI with */
+volatile register uint8_t usi_after         __asm__("r2") ;
+volatile register uint8_t usi_toggle        __asm__("r17") ;
+#endif
+volatile register uint8_t write_mask        __asm__("r4") ;
+volatile register uint8_t write_offset      __asm__("r5") ;
+volatile register uint8_t out_pins          __asm__("r6") ;
+volatile register uint8_t send_byte         __asm__("r7") ;
+volatile register uint8_t send_ptrl         __asm__("r8") ;
+volatile register uint8_t send_ptrh         __asm__("r9") ;
+volatile register uint8_t isr_zl            __asm__("r10") ;
+volatile register uint8_t isr_zh            __asm__("r11") ;
+volatile register uint8_t isr_sreg          __asm__("r12") ;
 volatile register uint8_t send_offset       __asm__("r13") ;
 volatile register uint8_t send_counter      __asm__("r14") ;
 volatile register uint8_t read_offset_id    __asm__("r15") ;
 volatile register uint8_t send_bit          __asm__("r16") ;
-volatile register uint8_t write_offset      __asm__("r17") ;
+#ifndef OUTPUT_USI
+volatile register uint8_t send_shifts       __asm__("r17") ;
+#endif
+#if PROTOCOL == PROTOCOL_INDALA
+/* zero, to write TCNT0 with */
+volatile register uint8_t isr_zero          __asm__("r2") ;
+#endif
+#if defined(TRACE) && PROTOCOL == PROTOCOL_EM41XX && !defined(OUTPUT_USI)
+/* TRACE_PIN's bit of DDRB, the timer interrupt call sends it along */
+volatile register uint8_t trace_ddr         __asm__("r3") ;
+#define TRACE_DDR
+#endif
+
+#if RING_ALIGN > 1
+/* offset in em_bits[] of the frame currently read by the interrupt call, the
+ * one of the byte before send_ptr */
+#define SEND_FRAME()            ((uint8_t)(send_ptrl - 1) & \
+                                 (sizeof(em_bits) - FRAME_SIZE))
 
-/* writes a manchester bit to em_bits[] & increment the write_offset */
-static void write_bit(uint8_t bit) 
+/* offset in em_bits[] of the frame after 'frame' */
+#define NEXT_FRAME(frame)       (((frame) + FRAME_SIZE) & (sizeof(em_bits) - 1))
+#else
+/* the same for frames which aren't a power of 2, without dividing */
+static uint8_t send_frame_offset(void)
 {
-    uint8_t b = (bit) ? 0 : OUT_PINS;
-    em_bits[write_offset++] = b;
+    uint8_t offset = (uint8_t)(send_ptrl - 1) - (uint8_t)(uint16_t)em_bits;
+    uint8_t frame = 0;
+    /* send_ptr wrapped to em_bits[0] already? */
+    if (offset >= sizeof(em_bits)) {
+        return sizeof(em_bits) - FRAME_SIZE;
+    }
+    while (offset >= frame + FRAME_SIZE) {
+        frame += FRAME_SIZE;
+    }
+    return frame;
 }
 
-/* writes a nibble and returns its parity */
-static uint8_t write_nibble(uint8_t nibble) 
+#define SEND_FRAME()            send_frame_offset()
+#define NEXT_FRAME(frame)       ((frame) + FRAME_SIZE < sizeof(em_bits) ? \
+                                 (frame) + FRAME_SIZE : 0)
+#endif
+
+/* number of times the interrupt call got to a frame before the main loop did,
+ * sending it again, up to 255. only when it's less than RING_FRAMES frames 
+ * behind, more & it looks just like it's on time. */
+#define UNDERRUNS               GPIOR1
+
+/* load one byte of current ID from em_id_list[], or hit_ids[] replaying */
+static uint8_t read_byte(uint8_t offset) 
 {
-    uint8_t x, parity = 0;
-    for(int i = 0; i < 4; i++) {
-        x = (nibble >> (3 - i)) & 0x1;
-        write_bit(x);
-        parity ^= x;
+#ifdef HIT_SENSE
+    if (hit_state != HIT_SWEEPING) {
+        return hit_ids[hit_offset][offset];
     }
-    return parity;
+#endif
+    return em_id_list[read_offset_id + offset];
 }
 
-/* write two nibbles of a byte plus their parity bit */
-static void write_byte(uint8_t c)
+/* the frame encoders & the ID generators, built for the host as well */
+#include "frames.c"
+
+#ifdef MUTATE
+/* flips the bits of mutation 'm' in frame 'frame' in em_bits[], undoing it 
+ * when it's there already */
+static void flip_mutation(uint8_t frame, uint8_t m)
 {
-    write_bit( write_nibble( NIBBLE_HIGH(c) ) );
-    write_bit( write_nibble( NIBBLE_LOW(c) ) );
+    uint8_t bit = pgm_read_byte(&mutations[m].bit);
+    uint8_t bits = pgm_read_byte(&mutations[m].bits);
+    for (; bits; bits--, bit++) {
+        em_bits[frame + bit / 8] ^= 0x80 >> (bit % 8);
+    }
 }
 
-/* load one byte of current ID from em_id_list[] */
-static uint8_t read_byte(uint8_t offset) 
+/* undoes the mutation of frame 'frame' in em_bits[], if it has one, so it's
+ * the ID of em_frame_id[] again */
+static void unmutate(uint8_t frame)
 {
-    return em_id_list[read_offset_id + offset];
+    uint8_t *m = &frame_mutation[frame / FRAME_SIZE];
+    if (*m != UNMUTATED) {
+        flip_mutation(frame, *m);
+        *m = UNMUTATED;
+    }
 }
 
-/* increment a 40bit (5 bytes) number in a buffer */
-static void inc_em_id(void)
+/* rolls the dice, a 16 bit xorshift, & mutates the freshly filled frame 
+ * 'frame' in em_bits[] when they say so */
+static void mutate(uint8_t frame)
 {
-    for (int8_t i = 4; i >= 0; i--) {
-        if (em_id_list[read_offset_id + i]++) break;
+    mutate_state ^= mutate_state << 7;
+    mutate_state ^= mutate_state >> 9;
+    mutate_state ^= mutate_state << 8;
+    if ((uint8_t)mutate_state >= MUTATE_CHANCE ||
+        profile.encoding == ENCODING_BIPHASE) {
+        return;
     }
+    uint8_t m = (uint8_t)(mutate_state >> 8) % MUTATIONS;
+    flip_mutation(frame, m);
+    frame_mutation[frame / FRAME_SIZE] = m;
 }
+#endif
 
-/* writes a static header (9 ones) at the begining of em_bits[] and a stop bit
- * (zero) at the end */
-static void write_em_header_footer(void) 
+#ifdef HIT_SENSE
+/* proceeds to the next ID of those replayed, the 1st one after the last */
+static void next_hit_offset(void)
 {
-    write_offset = 0;
-    for(uint8_t i = 0; i < 9; i++) {
-        write_bit(1);
+    if (++hit_offset >= hit_low + hit_size) {
+        hit_offset = hit_low;
     }
-    write_offset = 63;
-    write_bit(0);
 }
+#endif
 
-/* translates current ID from em_id_list[] to manchester encoding and writes to 
- * em_bits[] 
- */
-static void write_em_id(void) 
+/* writes the current ID to the frame at offset 'frame' in em_bits[], 
+ * increments it and proceeds to the next ID in em_id_list[] */
+static void next_em_id(uint8_t frame)
+{
+    /* write the current ID in the list */
+    write_id(frame);
+
+#ifdef HIT_SENSE
+    /* replaying a hit, the IDs of hit_ids[] from the oldest to the newest */
+    if (hit_state != HIT_SWEEPING) {
+        next_hit_offset();
+        return;
+    }
+#endif
+
+    /* increment the current ID in the list, the range's turn goes on for its
+     * weight, or until it starts over when it's DEPTH_FIRST */
+    uint8_t over = inc_em_id();
+    uint8_t weight = pgm_read_byte(&em_ranges[read_range].weight);
+    if (weight == DEPTH_FIRST ? !over : ++read_count < weight) {
+        return;
+    }
+    read_count = 0;
+
+    /* proceed to next ID in em_id_list[] */
+    read_offset_id += 5;
+    read_range++;
+
+    /* are we at the end of the profile's ranges ? */
+    if (read_range >= profile.first_range + profile.ranges) {
+        /* reset to its 1st ID in em_id_list[] */
+        read_range = profile.first_range;
+        read_offset_id = read_range * 5;
+    }
+}
+
+#if CHECKPOINT_IDS
+/* crc of 'size' bytes at 'p', in ram or flash */
+static uint8_t crc_block(uint8_t crc, const uint8_t *p, uint16_t size,
+                         uint8_t flash)
+{
+    while (size--) {
+        crc = _crc8_ccitt_update(crc, flash ? pgm_read_byte(p) : *p);
+        p++;
+    }
+    return crc;
+}
+
+/* restores em_id_list[] & read_range from the newest valid checkpoint, and 
+ * sets checkpoint_slot to it, so the next one is saved right after it */
+static void load_checkpoint(void)
+{
+    uint8_t found = 0;
+
+    const uint16_t dict_size = sizeof(em_dict);
+    ranges_crc = crc_block(0, (const uint8_t *)em_ranges, sizeof(em_ranges),
+                           1);
+    ranges_crc = crc_block(ranges_crc, (const uint8_t *)&dict_size, 2, 0);
+    checkpoint_offset = sizeof(checkpoint);
+    checkpoint_slot = CHECKPOINT_SLOTS - 1;
+    checkpoint_counter = 0;
+
+    for (uint8_t slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+        checkpoint_t c;
+        eeprom_read_block(&c, (const void *)(slot * sizeof(c)), sizeof(c));
+        if (crc_block(ranges_crc, &c.seq, sizeof(c) - 1, 0) != c.crc ||
+            c.range >= RANGES || c.dict > sizeof(em_dict)) {
+            continue;
+        }
+        /* newer than the one found so far, sequence numbers wrapping? */
+        if (found && (int8_t)(c.seq - checkpoint.seq) <= 0) {
+            continue;
+        }
+        memcpy(&checkpoint, &c, sizeof(c));
+        checkpoint_slot = slot;
+        found = 1;
+    }
+
+    if (found) {
+        memcpy(em_id_list, checkpoint.ids, sizeof(em_id_list));
+        read_range = checkpoint.range;
+        read_offset_id = read_range * 5;
+        dict_offset = checkpoint.dict;
+    } else {
+        checkpoint.seq = 0;
+    }
+}
+
+/* takes a checkpoint of the current position every CHECKPOINT_IDS IDs, to be
+ * written in the next slot by write_checkpoint() */
+static void save_checkpoint(void)
 {
-    uint8_t checksum = 0;
-    write_offset = 9;
-    for(uint8_t i = 0; i < 5; i++) {
-        uint8_t c = read_byte(i);
-        checksum ^= c;
-        write_byte( c );
+#ifdef HIT_SENSE
+    /* replaying a hit doesn't move on */
+    if (hit_state != HIT_SWEEPING) {
+        return;
+    }
+#endif
+    /* still writing the previous one? */
+    if (++checkpoint_counter < CHECKPOINT_IDS ||
+        checkpoint_offset < sizeof(checkpoint)) {
+        return;
+    }
+    checkpoint_counter = 0;
+
+    checkpoint.seq++;
+    checkpoint.range = read_range;
+    checkpoint.dict = dict_offset;
+    memcpy(checkpoint.ids, em_id_list, sizeof(em_id_list));
+    if (++checkpoint_slot >= CHECKPOINT_SLOTS) {
+        checkpoint_slot = 0;
     }
-    write_nibble( NIBBLE_HIGH(checksum) ^ NIBBLE_LOW(checksum) );
+    checkpoint_offset = 0;
+    checkpoint_crc = ranges_crc;
 }
 
-/* this interrupt procedure will be called every 32 clock cycles. it will 
- * increment the send_offset, send current manchester bit, and on each odd
+/* writes 'byte' to eeprom address 'addr', unless it's there already, without
+ * waiting for it. the eeprom has to be ready */
+static void eeprom_put(uint16_t addr, uint8_t byte)
+{
+    EEAR = addr;
+    EECR |= _BV(EERE);
+    if (EEDR != byte) {
+        EEDR = byte;
+        /* EEPE has to follow EEMPE within 4 cycles */
+        cli();
+        EECR = _BV(EEMPE);
+        EECR |= _BV(EEPE);
+        sei();
+    }
+}
+
+/* writes the next byte of the checkpoint once the eeprom is ready, without 
+ * waiting out the few milliseconds each byte takes. unchanged bytes are 
+ * skipped to spare the wear. */
+static void write_checkpoint(void)
+{
+    if (checkpoint_offset >= sizeof(checkpoint) || (EECR & _BV(EEPE))) {
+        return;
+    }
+
+    /* the last byte is the crc of all that's before it */
+    uint8_t *p = (uint8_t *)&checkpoint;
+    if (checkpoint_offset == sizeof(checkpoint) - 1) {
+        checkpoint.crc = checkpoint_crc;
+    } else {
+        checkpoint_crc = _crc8_ccitt_update(checkpoint_crc,
+                                            p[checkpoint_offset]);
+    }
+
+    eeprom_put(checkpoint_slot * sizeof(checkpoint) + checkpoint_offset,
+               p[checkpoint_offset]);
+    checkpoint_offset++;
+}
+
+#ifdef STATS
+/* restores the counters from the newest valid slot, or clears them, & counts
+ * this power up. the 1st ID done writes them out */
+static void load_stats(void)
+{
+    uint8_t found = 0;
+
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        stats_t s;
+        eeprom_read_block(&s, (const void *)(STATS_EEPROM + slot * sizeof(s)),
+                          sizeof(s));
+        if (crc_block(0, &s.seq, offsetof(stats_t, crc), 0) != s.crc ||
+            (found && (int8_t)(s.seq - stats.seq) <= 0)) {
+            continue;
+        }
+        memcpy(&stats, &s, sizeof(s));
+        stats_slot = slot;
+        found = 1;
+    }
+    if (!found) {
+        memset(&stats, 0, sizeof(stats));
+        stats_slot = 1;
+    }
+    stats.boots++;
+    stats.frame_size = FRAME_SIZE;
+    stats_offset = sizeof(stats_out);
+    stats_counter = CHECKPOINT_IDS - 1;
+}
+
+/* copies the counters every CHECKPOINT_IDS IDs, to be written to the other 
+ * slot by write_stats() */
+static void save_stats(void)
+{
+    /* still writing the previous copy? */
+    if (++stats_counter < CHECKPOINT_IDS || stats_offset < sizeof(stats_out)) {
+        return;
+    }
+    stats_counter = 0;
+
+    stats.seq++;
+    memcpy(&stats_out, &stats, sizeof(stats));
+    stats_out.crc = crc_block(0, &stats_out.seq, offsetof(stats_t, crc), 0);
+    stats_slot ^= 1;
+    stats_offset = 0;
+}
+
+/* writes the next byte of the copy, like write_checkpoint() */
+static void write_stats(void)
+{
+    if (stats_offset >= sizeof(stats_out) || (EECR & _BV(EEPE))) {
+        return;
+    }
+    eeprom_put(STATS_EEPROM + stats_slot * sizeof(stats_out) + stats_offset,
+               ((uint8_t *)&stats_out)[stats_offset]);
+    stats_offset++;
+}
+#endif
+#endif
+
+#if PROTOCOL == PROTOCOL_HID
+/* this interrupt procedure will be called by timer1 every 50 clock cycles, 
+ * once per FSK symbol. it shifts the next symbol out of send_byte & sets 
+ * timer0's TOP to it, fc/10 for a set bit & fc/8 otherwise, which timer0 
+ * takes on at the end of the subcarrier cycle on air, so the timing of the 
+ * call doesn't matter. 
+ *
+ * send_byte is reloaded every 8 calls, once send_shifts wraps, from send_ptr
+ * which is compared to the end of em_bits[] to wrap it. send_bit is our 
+ * scratch register. the call takes 19 cycles, 30 when reloading (including 
+ * the interrupt response & vector jump).
+ */
+ISR(TIMER1_COMPA_vect) __attribute__ ((naked));
+ISR(TIMER1_COMPA_vect) 
+{
+    asm volatile(
+        /* timer0 TOP of the next symbol, FSK_TOP0 or FSK_TOP1 */
+        "in   %[sreg], __SREG__\n"
+        "lsl  %[byte]\n"
+        "sbc  %[tmp], %[tmp]\n"
+        "andi %[tmp], %[diff]\n"
+        "subi %[tmp], -%[top0]\n"
+        "out  %[ocr], %[tmp]\n"
+        /* exit unless send_byte is all shifted out */
+        "subi %[shifts], 0x20\n"
+        "breq 2f\n"
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        /* load send_byte from send_ptr, wrapping it at the end & exit */
+        "2:\n"
+        "movw %[zl], r30\n"
+        "movw r30, %[ptrl]\n"
+        "ld   %[byte], Z+\n"
+        "cpi  r30, lo8(em_bits + %[size])\n"
+        "brne 3f\n"
+        "ldi  r30, lo8(em_bits)\n"
+        "ldi  r31, hi8(em_bits)\n"
+        "3:\n"
+        "movw %[ptrl], r30\n"
+        "movw r30, %[zl]\n"
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        : [byte] "+r" (send_byte), [tmp] "+d" (send_bit), 
+          [shifts] "+d" (send_shifts), [ptrl] "+r" (send_ptrl), 
+          [sreg] "=r" (isr_sreg), [zl] "=r" (isr_zl)
+        : [ocr] "I" (_SFR_IO_ADDR(OCR0A)), [top0] "M" (FSK_TOP0),
+          [diff] "M" (FSK_TOP1 - FSK_TOP0), [size] "M" (sizeof(em_bits))
+    );
+}
+
+#elif PROTOCOL == PROTOCOL_INDALA
+/* this interrupt procedure will be called by timer1 every 32 clock cycles, 
+ * once per PSK bit. timer0 toggles the subcarrier on every cycle, and when 
+ * the bit shifted out of send_byte differs from the last one, kept in 
+ * send_offset, writing TCNT0 blocks the next toggle & flips its phase. that 
+ * happens 5 cycles into every call, which keeps the bits even on air.
+ *
+ * send_byte is reloaded every 8 calls, once send_shifts wraps, from send_ptr
+ * which runs over em_bits[] & wraps back to its beginning like with EM41xx.
+ * send_bit is our scratch register. the call takes 19 cycles, 27 when 
+ * reloading (including the interrupt response & vector jump). TCNT0 is 
+ * written 11 to 14 cycles after timer1's match, 15 waking the main loop up,
+ * so the phase flips jitter by up to 4 cycles like the EM41xx edges.
+ */
+ISR(TIMER1_COMPA_vect) __attribute__ ((naked));
+ISR(TIMER1_COMPA_vect) 
+{
+    asm volatile(
+        /* flip the phase unless the next bit is the same as the last one */
+        "in   %[sreg], __SREG__\n"
+        "lsl  %[byte]\n"
+        "sbc  %[bit], %[bit]\n"
+        "cpse %[bit], %[last]\n"
+        "out  %[tcnt], %[zero]\n"
+        "mov  %[last], %[bit]\n"
+        /* exit unless send_byte is all shifted out */
+        "subi %[shifts], 0x20\n"
+        "breq 2f\n"
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        /* load send_byte from send_ptr & exit */
+        "2:\n"
+        "movw %[zl], r30\n"
+        "movw r30, %[ptrl]\n"
+        "ld   %[byte], Z+\n"
+        "cbr  r30, %[size]\n"
+        "movw %[ptrl], r30\n"
+        "movw r30, %[zl]\n"
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        : [last] "+r" (send_offset), [bit] "+r" (send_bit),
+          [byte] "+r" (send_byte), [shifts] "+d" (send_shifts),
+          [ptrl] "+r" (send_ptrl), [sreg] "=r" (isr_sreg), 
+          [zl] "=r" (isr_zl)
+        : [tcnt] "I" (_SFR_IO_ADDR(TCNT0)), [zero] "r" (isr_zero),
+          [size] "M" (sizeof(em_bits))
+    );
+}
+
+#elif !defined(OUTPUT_USI)
+/* this interrupt procedure will be called every 32 clock cycles (RF/64). it
+ * will increment the send_offset, send current manchester bit, and on each odd
  * send_offset it will xor the current bit (since manchester encoding are always
- * reverted) and prepare it for the next call, otherwise it will load the next 
- * bit to be sent on the next call.
+ * reverted) and prepare it for the next call, otherwise it will shift the next 
+ * bit to be sent on the next call out of send_byte.
+ *
+ * send_byte is reloaded on every 8th odd send_offset, once send_shifts wraps,
+ * from send_ptr which runs over em_bits[] & wraps back to its beginning.
+ *
+ * the main loop keeps encoding while we're sending, so nothing but our own
+ * registers may be touched here: SREG is kept in isr_sreg and Z in isr_zl/zh.
+ * every path sends its bit 3 cycles into the call & takes 20 cycles, 27 when
+ * reloading (including the interrupt response & vector jump), leaving the
+ * main loop the rest at an even pace. with TRACE the even path adds trace_ddr
+ * to the bit, which the odd one keeps, & both take 21 cycles. a frame ends
+ * when send_ptr moves on to the next one, which is what SEND_FRAME() tells
+ * the main loop.
  *
- * we want this procedure to use less than ~20 cycles to provide the main loop 
- * enough cycles to check for current send_offset and reset it or pause the
- * interrupt routine and increment to next ID when needed.
+ * the bit goes out 9 to 12 cycles after the compare match, the response
+ * waiting for up to 3 cycles of the instruction it interrupts, & 13 when it
+ * wakes the main loop up, which sleeps whenever it's idle: up to 4 cycles of
+ * jitter on the edges, an eighth of a half bit.
  */
 ISR(TIMER0_COMPA_vect) __attribute__ ((naked));
 ISR(TIMER0_COMPA_vect) 
 {
-    /* increment send_offset & send current manchester bit */
     asm volatile(
-        "inc %[offset]\n"
-        "out %[port], %[bit]\n"
-        : [offset] "=r" (send_offset)
-        : [port] "I" (_SFR_IO_ADDR(DDRB)), [bit] "r" (send_bit)
+        /* increment send_offset & send current manchester bit */
+        "in   %[sreg], __SREG__\n"
+        "inc  %[offset]\n"
+        "out  %[port], %[bit]\n"
+        /* if send_offset is odd, xor send_bit */
+        "sbrs %[offset], 0\n"
+        "rjmp 1f\n"
+        "eor  %[bit], %[pins]\n"
+        /* exit unless send_byte is all shifted out */
+        "subi %[shifts], 0x20\n"
+        "breq 2f\n"
+        /* as long as the even path */
+        "nop\n"
+#ifdef TRACE_DDR
+        "nop\n"
+#endif
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        /* load send_byte from send_ptr & exit */
+        "2:\n"
+        "movw %[zl], r30\n"
+        "movw r30, %[ptrl]\n"
+        "ld   %[byte], Z+\n"
+        "cbr  r30, %[size]\n"
+        "movw %[ptrl], r30\n"
+        "movw r30, %[zl]\n"
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        /* shift next bit out of send_byte & exit */
+        "1:\n"
+        "lsl  %[byte]\n"
+        "sbc  %[bit], %[bit]\n"
+        "and  %[bit], %[pins]\n"
+#ifdef TRACE_DDR
+        "or   %[bit], %[trace]\n"
+#endif
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        : [offset] "+r" (send_offset), [bit] "+r" (send_bit),
+          [byte] "+r" (send_byte), [shifts] "+d" (send_shifts),
+          [ptrl] "+r" (send_ptrl), [sreg] "=r" (isr_sreg), 
+          [zl] "=r" (isr_zl)
+        : [port] "I" (_SFR_IO_ADDR(DDRB)), [pins] "r" (out_pins),
+          [size] "M" (sizeof(em_bits))
+#ifdef TRACE_DDR
+          , [trace] "r" (trace_ddr)
+#endif
     );
-    /* if send_offset is odd, xor send_bit & exit */
-    if (send_offset & 1) {
-        send_bit ^= OUT_PINS;
-        /* avoid 'else' to save a few cycles (rjmp) */
-        asm("reti\n");
-    }
-    /* load next bit & exit */
-    send_bit = em_bits[send_offset/2];
-    asm("reti\n");
 }
 
-/* setting timer0 to Clear Timer on Compare mode every 32 cycles */
+#else
+
+/* the 8 manchester half bits of each nibble in em_bits[], msb first */
+const uint8_t usi_bits[16] PROGMEM = {
+                        0x55, 0x56, 0x59, 0x5A, 0x65, 0x66, 0x69, 0x6A, 
+                        0x95, 0x96, 0x99, 0x9A, 0xA5, 0xA6, 0xA9, 0xAA
+                        };
+
+/* this interrupt procedure will be called once the USI has shifted out all 8 
+ * half bits of USIDR, every 4 * DATA_RATE clock cycles. it will load USIDR
+ * with usi_next right away, since the next timer0 compare match is only a half
+ * bit (16 cycles at RF/32) away, then move usi_after up to usi_next, advance 
+ * send_offset by 8 half bits and prepare usi_after from the following nibble 
+ * of em_bits[]. send_bit is our scratch register, it's not needed here.
+ *
+ * until USIDR is loaded DO shows the bit shifted in from DI (PB0) on the 1st 
+ * shift of the byte before, for 7 cycles (11 waking up). so PB0 is an output
+ * kept at the 1st half bit of the byte after the one going out: toggled by 
+ * usi_toggle right after loading USIDR, 8 cycles (12) into the half bit &
+ * before its shift, & the byte after next is prepared a call ahead for it. 
+ * the whole call takes 38 cycles, 44 when loading a new send_byte.
+ */
+ISR(USI_OVF_vect) __attribute__ ((naked));
+ISR(USI_OVF_vect) 
+{
+    asm volatile(
+        /* send the next 8 half bits, DI for the ones after & count them */
+        "out  %[usidr], %[next]\n"
+        "out  %[pinb], %[toggle]\n"
+        "in   %[sreg], __SREG__\n"
+        "ldi  %[tmp], %[count]\n"
+        "out  %[usisr], %[tmp]\n"
+        "mov  %[next], %[after]\n"
+        "ldi  %[tmp], 8\n"
+        "add  %[offset], %[tmp]\n"
+        /* low nibble of send_byte is next on odd bytes of USIDR */
+        "movw %[zl], r30\n"
+        "mov  %[tmp], %[byte]\n"
+        "sbrs %[offset], 3\n"
+        "rjmp 1f\n"
+        /* otherwise load send_byte from send_ptr & use its high nibble */
+        "movw r30, %[ptrl]\n"
+        "ld   %[byte], Z+\n"
+        "cbr  r30, %[size]\n"
+        "movw %[ptrl], r30\n"
+        "mov  %[tmp], %[byte]\n"
+        "swap %[tmp]\n"
+        /* usi_after = usi_bits[nibble] */
+        "1:\n"
+        "andi %[tmp], 0x0F\n"
+        "mov  r30, %[tmp]\n"
+        "ldi  r31, 0\n"
+        "subi r30, lo8(-(usi_bits))\n"
+        "sbci r31, hi8(-(usi_bits))\n"
+        "lpm  %[after], Z\n"
+        /* toggle PB0 (bit 0) next call if bit 7 of both differs & exit */
+        "mov  %[toggle], %[next]\n"
+        "eor  %[toggle], %[after]\n"
+        "lsl  %[toggle]\n"
+        "clr  %[toggle]\n"
+        "rol  %[toggle]\n"
+        "movw r30, %[zl]\n"
+        "out  __SREG__, %[sreg]\n"
+        "reti\n"
+        : [offset] "+r" (send_offset), [next] "+r" (usi_next),
+          [after] "+r" (usi_after), [toggle] "+r" (usi_toggle),
+          [byte] "+r" (send_byte), [tmp] "+d" (send_bit),
+          [ptrl] "+r" (send_ptrl), [sreg] "=r" (isr_sreg), 
+          [zl] "=r" (isr_zl)
+        : [usidr] "I" (_SFR_IO_ADDR(USIDR)), 
+          [usisr] "I" (_SFR_IO_ADDR(USISR)),
+          [pinb] "I" (_SFR_IO_ADDR(PINB)),
+          [count] "M" (_BV(USIOIF) | (16 - 8)),
+          [size] "M" (sizeof(em_bits))
+    );
+}
+
+#endif
+
+/* setting timer0 to Clear Timer on Compare mode every 32 cycles, or with HID
+ * & Indala to the subcarrier & timer1 to the bits */
 static void set_timers(void)
 {
+#if PROTOCOL == PROTOCOL_HID
+    /* timer0 in fast PWM mode up to OCR0A, setting OC0B at the bottom & 
+     * clearing it at OCR0B, which is the subcarrier once PB1 is an output */
+    TCCR0A  = _BV(COM0B1) | _BV(WGM01) | _BV(WGM00);
+    TCCR0B  = _BV(WGM02) | _BV(CS00);
+    OCR0A   = FSK_TOP0;
+    OCR0B   = FSK_DUTY;
+#elif PROTOCOL == PROTOCOL_INDALA
+    /* timer0 in CTC mode toggling OC0B on every cycle, fc/2 */
+    TCCR0A  = _BV(COM0B0) | _BV(WGM01);
+    TCCR0B  = _BV(CS00);
+    OCR0A   = 0;
+    OCR0B   = 0;
+#endif
+#if PROTOCOL != PROTOCOL_EM41XX
+    TCNT0   = 0;
+    /* timer1 in CTC mode, interrupting once per bit */
+    TCCR1   = _BV(CTC1) | _BV(CS10);
+    OCR1C   = DATA_RATE - 1;
+    OCR1A   = DATA_RATE - 1;
+    TIMSK  |= _BV(OCIE1A);
+#else
     /* timer0 in CTC mode and clear other bits */
     TCCR0A  = _BV(WGM01);
     /* timer0 no prescaling */
     TCCR0B  = _BV(CS00);
+#ifndef OUTPUT_USI
     /* enable timer0 compare interrupt */
     TIMSK  |= _BV(OCIE0A);
+#else
+    /* USI in three-wire mode clocked by timer0 compare, with its overflow 
+     * interrupt & DO as output, DI too as the interrupt call drives it */
+    USICR   = _BV(USIWM0) | _BV(USICS0) | _BV(USIOIE);
+    DDRB   |= _BV(PINB1) | _BV(PINB0);
+#endif
     /* set timer0 current counter */
     TCNT0   = 0;
     /* set timer0 for every xx cycles */
     OCR0A   = MAX_TIMER0;
+#ifdef OUTPUT_USI
+    /* or the profile's own data rate */
+    if (profile.rate) {
+        OCR0A = profile.rate / 2 - 1;
+    }
+#endif
+#endif
+}
+
+/* sets the interrupt call to send from the 1st frame in em_bits[] & starts it
+ * - we're sending, hooray! */
+static void start_sending(void)
+{
+    out_pins        = OUT_PINS;
+    send_byte       = em_bits[0];
+    send_ptrl       = (uint16_t)&em_bits[1];
+    send_ptrh       = (uint16_t)&em_bits[1] >> 8;
+#if PROTOCOL != PROTOCOL_EM41XX
+    /* the 1st bit shifts out on the 1st call, the subcarrier goes on air */
+    send_offset     = 0;
+    send_shifts     = 0;
+#if PROTOCOL == PROTOCOL_INDALA
+    isr_zero        = 0;
+#endif
+    DDRB           |= _BV(PINB1);
+#elif !defined(OUTPUT_USI)
+    /* the frame before it is all done */
+    send_offset     = 255;
+    send_bit        = 0;
+    send_shifts     = 0;
+#else
+    /* the 1st nibble goes to USIDR, the 2nd waits in usi_next & the 3rd in
+     * usi_after, so the 1st call takes the low nibble of em_bits[1] */
+    USIDR           = pgm_read_byte(&usi_bits[NIBBLE_HIGH(send_byte)]);
+    usi_next        = pgm_read_byte(&usi_bits[NIBBLE_LOW(send_byte)]);
+    send_byte       = em_bits[1];
+    send_ptrl       = (uint16_t)&em_bits[2];
+    send_ptrh       = (uint16_t)&em_bits[2] >> 8;
+    usi_after       = pgm_read_byte(&usi_bits[NIBBLE_HIGH(send_byte)]);
+    send_offset     = 8;
+    /* DI at usi_next's 1st half bit, its shift into USIDR comes out next */
+    if (usi_next & 0x80) {
+        PORTB |= _BV(PINB0);
+    } else {
+        PORTB &= ~_BV(PINB0);
+    }
+    usi_toggle      = ((usi_next ^ usi_after) & 0x80) ? _BV(PINB0) : 0;
+    USISR           = _BV(USIOIF) | (16 - 8);
+#endif
+    sei();
+}
+
+/* loads profiles[PROFILE], or with STRAPS the one the strap pins pick, & 
+ * fits its ranges to em_ranges[] */
+static void load_profile(void)
+{
+    uint8_t index = PROFILE;
+#ifdef STRAPS
+    /* pull the straps up for a moment, the ones tied to ground read 0 */
+    PORTB  |= STRAP_PINS;
+    __asm__ __volatile__ ("nop");
+    uint8_t pins = ~PINB & STRAP_PINS;
+    PORTB  &= ~STRAP_PINS;
+    /* no more reading them, their input buffers are off so they can float */
+    DIDR0  |= STRAP_PINS;
+
+    /* the strap pins to bits of the profile number, lowest pin 1st */
+    uint8_t straps = 0, bit = 1;
+    for (uint8_t pin = _BV(PINB1); pin <= _BV(PINB5); pin <<= 1) {
+        if (STRAP_PINS & pin) {
+            if (pins & pin) {
+                straps |= bit;
+            }
+            bit <<= 1;
+        }
+    }
+    if (PROFILE + straps < sizeof(profiles) / sizeof(profile_t)) {
+        index = PROFILE + straps;
+    }
+#endif
+    memcpy_P(&profile, &profiles[index], sizeof(profile));
+#ifdef TRACE
+    profile_index = index;
+#endif
+
+    if (profile.first_range >= RANGES) {
+        profile.first_range = 0;
+    }
+    if (!profile.ranges || profile.ranges > RANGES - profile.first_range) {
+        profile.ranges = RANGES - profile.first_range;
+    }
+}
+
+/* turns off what we don't use, drawing less from the reader's field */
+static void set_power(void)
+{
+    /* analog comparator off */
+    ACSR    = _BV(ACD);
+    /* no ADC, timer1 unless it's clocking the bits & USI unless it's sending 
+     * them */
+#if PROTOCOL != PROTOCOL_EM41XX
+    PRR     = _BV(PRADC) | _BV(PRUSI);
+#elif !defined(OUTPUT_USI)
+    PRR     = _BV(PRADC) | _BV(PRTIM1) | _BV(PRUSI);
+#else
+    PRR     = _BV(PRADC) | _BV(PRTIM1);
+#endif
+    /* the main loop sleeps in idle mode, keeping the timers running */
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+}
+
+#if (defined(HIT_SENSE) && HIT_MODE == HIT_BISECT) || defined(BURST)
+/* lets go of the coil while 'quiet', the interrupt call goes on sending */
+static void set_quiet(uint8_t quiet)
+{
+#if PROTOCOL == PROTOCOL_EM41XX && !defined(OUTPUT_USI)
+    out_pins = quiet ? 0 : OUT_PINS;
+#else
+    if (quiet) {
+        DDRB &= ~_BV(PINB1);
+    } else {
+        DDRB |= _BV(PINB1);
+    }
+#endif
 }
+#endif
 
-/* an endless loop to send IDs from em_id_list[] & increment them. */
+#ifdef HIT_SENSE
+/* keeps the ID of frame 'frame', which just went on air, in hit_ids[] */
+static void log_hit_id(uint8_t frame)
+{
+    const uint8_t *id = em_frame_id[frame / FRAME_SIZE];
+    if (hit_count && !memcmp(id, hit_ids[hit_newest], 5)) {
+        return;
+    }
+    if (++hit_newest >= HIT_IDS) {
+        hit_newest = 0;
+    }
+    memcpy(hit_ids[hit_newest], id, 5);
+    if (hit_count < HIT_IDS) {
+        hit_count++;
+    }
+}
+
+/* stops sending for good: the coil & PB1 let go, the led on & powered down
+ * with the interrupts off, so only a power cycle wakes us up */
+static void halt(void)
+{
+    cli();
+    TIMSK   = 0;
+    TCCR0A  = 0;
+    TCCR0B  = 0;
+    TCCR1   = 0;
+    USICR   = 0;
+    DDRB    = _BV(PINB0);
+    PORTB   = _BV(PINB0);
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    while (1) {
+        sleep_cpu();
+    }
+}
+
+#if HIT_MODE == HIT_BISECT
+/* goes quiet before a round of the 1st half of the candidates left, or of 
+ * the last one to confirm it. the frames filled while quiet are the round's 
+ * already */
+static void start_round(void)
+{
+    hit_low     = cand_low;
+    hit_size    = cand_size > 1 ? cand_size / 2 : 1;
+    hit_offset  = hit_low;
+    hit_frames  = HIT_QUIET;
+    hit_state   = HIT_QUIET_ROUND;
+    set_quiet(1);
+}
+
+/* narrows the candidates down to the half of the round if 'hit', else to the
+ * other half, & starts the next round. with one left a hit confirms it: it's
+ * saved to the replay slot & sent from then on */
+static void end_round(uint8_t hit)
+{
+    if (cand_size == 1) {
+        if (hit) {
+            eeprom_update_block(hit_ids[cand_low],
+                                (void *)(HIT_EEPROM + offsetof(hit_t, replay)),
+                                5);
+            eeprom_update_byte((uint8_t *)(HIT_EEPROM +
+                                           offsetof(hit_t, winner)), 0);
+            hit_state = HIT_REPLAYING;
+            return;
+        }
+        /* it wasn't that one after all, all over again */
+        cand_low    = 0;
+        cand_size   = hit_count;
+    } else if (hit) {
+        cand_size   = hit_size;
+    } else {
+        cand_low   += hit_size;
+        cand_size  -= hit_size;
+    }
+    start_round();
+}
+
+/* counts down the frames of the quiet & of the round, once per frame filled */
+static void count_hit_frame(void)
+{
+    if (hit_state < HIT_QUIET_ROUND || --hit_frames) {
+        return;
+    }
+    if (hit_state == HIT_QUIET_ROUND) {
+        /* the reader had its time to let go, changes count again */
+        GIFR        = _BV(PCIF);
+        hit_frames  = HIT_ROUND;
+        hit_state   = HIT_ROUND_ON;
+        set_quiet(0);
+    } else {
+        end_round(0);
+    }
+}
+#endif
+
+/* saves hit_ids[] to the hit record, newest first, and halts, replays them 
+ * or starts bisecting them, sorted oldest first. the eeprom is written on the
+ * spot, the few frames lost to it on air are the ones in em_bits[] once more,
+ * which is what we'd replay anyway */
+static void hit(void)
+{
+    hit_t record;
+    memset(&record, 0xFF, sizeof(record));
+    record.hits = eeprom_read_byte((const uint8_t *)HIT_EEPROM);
+    record.hits = record.hits == 0xFF ? 1 : record.hits + (record.hits < 0xFE);
+    record.count = hit_count;
+    uint8_t i = hit_newest;
+    for (uint8_t n = 0; n < hit_count; n++) {
+        memcpy(record.ids[n], hit_ids[i], 5);
+        i = i ? i - 1 : HIT_IDS - 1;
+    }
+    /* the replay slot stays as it is */
+    eeprom_update_block(&record, (void *)HIT_EEPROM, offsetof(hit_t, winner));
+
+#if HIT_MODE == HIT_HALT
+    halt();
+#else
+#ifdef BURST
+    /* no more bursts, nor the rest of the pause we might be in */
+    burst_frames    = 0;
+    burst_quiet     = 0;
+    burst_muted     = 0;
+    set_quiet(0);
+#endif
+    for (uint8_t n = 0; n < hit_count; n++) {
+        memcpy(hit_ids[n], record.ids[hit_count - 1 - n], 5);
+    }
+    hit_low     = 0;
+    hit_size    = hit_count;
+    hit_offset  = 0;
+#if HIT_MODE == HIT_REPLAY
+    hit_state   = HIT_REPLAYING;
+#else
+    cand_low    = 0;
+    cand_size   = hit_count;
+    start_round();
+#endif
+#endif
+}
+
+/* acts on a change of the sense line, once per loop */
+static void watch_hit(void)
+{
+    if (!(GIFR & _BV(PCIF))) {
+        return;
+    }
+    if (hit_state == HIT_SWEEPING && hit_count) {
+        hit();
+#if HIT_MODE == HIT_BISECT
+    } else if (hit_state == HIT_ROUND_ON) {
+        end_round(1);
+#endif
+    }
+}
+
+#ifdef REPLAY_WINNER
+/* replays the winner of the last bisect from the replay slot, if there's one */
+static void load_winner(void)
+{
+    if (eeprom_read_byte((const uint8_t *)(HIT_EEPROM +
+                                           offsetof(hit_t, winner)))) {
+        return;
+    }
+    eeprom_read_block(hit_ids[0],
+                      (const void *)(HIT_EEPROM + offsetof(hit_t, replay)), 5);
+    hit_count   = 1;
+    hit_low     = 0;
+    hit_size    = 1;
+    hit_offset  = 0;
+    hit_state   = HIT_REPLAYING;
+}
+#endif
+#endif
+
+#ifdef BURST
+/* starts a pause of BURST_PAUSE frames, backed off */
+static void start_pause(void)
+{
+    burst_count     = 0;
+    burst_frames    = BURST_PAUSE << burst_backoff;
+}
+
+/* takes frame 'frame' to fill for the pause when there's one, or when the
+ * burst is done if 'next', an ID being due. 1 if it did, the frame is left as
+ * it is & goes quiet once on air */
+static uint8_t burst_fill(uint8_t frame, uint8_t next)
+{
+    const uint8_t bit = 1 << (frame / FRAME_SIZE);
+
+#ifdef HIT_SENSE
+    if (hit_state != HIT_SWEEPING) {
+        return 0;
+    }
+#endif
+    if (!burst_frames && next) {
+        if (burst_count >= BURST_IDS) {
+            /* a burst without a lockout, the reader might take more */
+            if (burst_backoff) {
+                burst_backoff--;
+            }
+            start_pause();
+        } else {
+#ifdef BURST_PIN
+            if (!burst_count) {
+                burst_range = read_range;
+                burst_dict  = dict_offset;
+                memcpy(burst_ids, em_id_list, sizeof(em_id_list));
+            }
+#endif
+            burst_count++;
+        }
+    }
+    if (burst_frames) {
+        burst_frames--;
+        burst_quiet |= bit;
+        return 1;
+    }
+    burst_quiet &= ~bit;
+    return 0;
+}
+
+/* lets go of the coil or takes it again once frame 'frame' is on air, if it's
+ * one of the pause or the 1st after it */
+static void burst_frame(uint8_t frame)
+{
+    const uint8_t quiet = (burst_quiet >> (frame / FRAME_SIZE)) & 1;
+
+    if (quiet == burst_muted) {
+        return;
+    }
+    burst_muted = quiet;
+    set_quiet(quiet);
+#ifdef BURST_PIN
+    /* the reader had the pause to let go of its lockout led */
+    if (!quiet) {
+        GIFR = _BV(PCIF);
+    }
+#endif
+}
+
+#ifdef BURST_PIN
+/* on a change of BURST_PIN during a burst, pauses right away with the pause
+ * doubled & rewinds to the burst's 1st ID, which the reader may not have had
+ * a look at */
+static void watch_lockout(void)
+{
+    if (!(GIFR & _BV(PCIF))) {
+        return;
+    }
+    GIFR = _BV(PCIF);
+    if (burst_frames || burst_muted || !burst_count) {
+        return;
+    }
+    memcpy(em_id_list, burst_ids, sizeof(em_id_list));
+    read_range      = burst_range;
+    read_offset_id  = read_range * 5;
+    read_count      = 0;
+    dict_offset     = burst_dict;
+    send_counter    = profile.repeat;
+    if (burst_backoff < BURST_BACKOFF) {
+        burst_backoff++;
+    }
+    start_pause();
+}
+#endif
+#endif
+
+#if defined(TRACE) || defined(STATS)
+/* the byte of the frame on air the interrupt call is sending */
+static uint8_t frame_byte(void)
+{
+    uint8_t offset = (uint8_t)(send_ptrl - 1) - (uint8_t)(uint16_t)em_bits;
+    /* send_ptr wrapped to em_bits[0] already? */
+    if (offset >= sizeof(em_bits)) {
+        offset = sizeof(em_bits) - 1;
+    }
+    return offset % FRAME_SIZE;
+}
+#endif
+
+#ifdef TRACE
+/* ticks per byte of em_bits[] on air, & the flag of the tick when it isn't
+ * the interrupt call's own */
+#if PROTOCOL == PROTOCOL_EM41XX
+#define TRACE_BYTE_TICKS        16
+#define TRACE_FLAG              OCF0A
+#else
+#define TRACE_BYTE_TICKS        8
+#define TRACE_FLAG              OCF1B
+#endif
+
+/* a byte has to fit the room left once the main loop is past the 1st byte
+ * of a frame, which filling it may take, or it's never sent: TRACE_TICKS up
+ * to 8 for EM41xx, 4 for HID & Indala */
+#if 11 * TRACE_TICKS > (FRAME_SIZE - 2) * TRACE_BYTE_TICKS
+#error "TRACE_TICKS is too long, a trace byte wouldn't fit a frame"
+#endif
+
+/* counts the frames gone on air & notes another ID, once the interrupt call
+ * moved on to frame 'frame', 'started' frames after the last one */
+static void trace_frame(uint8_t frame, uint8_t started)
+{
+    const uint8_t *id = em_frame_id[frame / FRAME_SIZE];
+    trace_frames += started;
+    if (memcmp(id, trace_id, 5)) {
+        memcpy(trace_id, id, 5);
+        trace_due = 1;
+    }
+}
+
+/* the ticks left to the end of the frame on air, at least */
+static uint8_t trace_room(void)
+{
+    /* the bytes after the one on air */
+    return (FRAME_SIZE - 1 - frame_byte()) * TRACE_BYTE_TICKS;
+}
+
+/* puts 'bit' on TRACE_PIN, TRACE_TICKS ticks after the last one */
+static void trace_bit(uint8_t bit)
+{
+#ifdef TRACE_DDR
+    /* the even call ending the bit takes trace_ddr, so it's set during the 
+     * two calls before it */
+    while (((uint8_t)(send_offset + 2) & (TRACE_TICKS - 1)) >= 2) {
+    }
+    trace_ddr = bit ? 0 : _BV(TRACE_PIN);
+    while (((uint8_t)(send_offset + 2) & (TRACE_TICKS - 1)) < 2) {
+    }
+#else
+    for (uint8_t i = 0; i < TRACE_TICKS; i++) {
+        while (!(TIFR & _BV(TRACE_FLAG))) {
+        }
+        TIFR = _BV(TRACE_FLAG);
+    }
+    if (bit) {
+        PORTB |= _BV(TRACE_PIN);
+    } else {
+        PORTB &= ~_BV(TRACE_PIN);
+    }
+#endif
+}
+
+/* sends the next byte of the trace from the idle main loop, when there's one
+ * & it ends before the frame on air does. 1 if it did */
+static uint8_t trace_idle(void)
+{
+    if (trace_next >= sizeof(trace_record)) {
+        if (!trace_due) {
+            return 0;
+        }
+        trace_record[0] = 0xA5;
+        trace_record[1] = trace_frames;
+        trace_record[2] = trace_frames >> 8;
+        memcpy(&trace_record[3], trace_id, 5);
+        trace_record[8] = profile_index;
+        trace_next = 0;
+        trace_due = 0;
+    }
+    /* a tick's wait for the start bit, 10 bits & the stop bit is out */
+    if (trace_room() < 11 * TRACE_TICKS) {
+        return 0;
+    }
+
+    uint8_t byte = trace_record[trace_next++];
+#ifndef TRACE_DDR
+    TIFR = _BV(TRACE_FLAG);
+#endif
+    trace_bit(0);
+    for (uint8_t i = 0; i < 8; i++) {
+        trace_bit(byte & 1);
+        byte >>= 1;
+    }
+    trace_bit(1);
+    return 1;
+}
+#endif
+
+/* an endless loop to send IDs from em_ranges[] & increment them. */
 int main(void)
 {
-    /* initalizing the timer */
+    /* load the profile, the timer needs its rate */
+    load_profile();
+
+    /* initalizing the timer & powering off the rest */
     set_timers();
+    set_power();
 
+#ifndef OUTPUT_USI
     /* setting debugging led */
     DDRB   |= _BV(PINB0);
     PORTB  ^= _BV(PINB0);
+#endif
+#ifdef RATE_PROBE
+    /* on for DATA_RATE */
+    DDRB   |= _BV(PROBE_PIN);
+    PORTB  |= _BV(PROBE_PIN);
+#endif
+
+#ifdef TRACE
+    /* the line idles high, released or driven */
+#ifdef TRACE_DDR
+    trace_ddr       = 0;
+    PORTB          &= ~_BV(TRACE_PIN);
+#else
+    PORTB          |= _BV(TRACE_PIN);
+    DDRB           |= _BV(TRACE_PIN);
+#if PROTOCOL != PROTOCOL_EM41XX
+    /* timer1's compare B flags the ticks */
+    OCR1B           = 0;
+#endif
+#endif
+    trace_next      = sizeof(trace_record);
+    trace_frames    = 0;
+#endif
+
+#ifdef HIT_SENSE
+    /* pull the sense line up & flag its changes, without an interrupt call.
+     * the flag is cleared once the line had the time to settle */
+    PORTB  |= _BV(HIT_PIN);
+    PCMSK   = _BV(HIT_PIN);
+    hit_newest      = 0;
+    hit_count       = 0;
+    hit_state       = HIT_SWEEPING;
+#endif
+#ifdef BURST
+    burst_count     = 0;
+    burst_frames    = 0;
+    burst_backoff   = 0;
+    burst_quiet     = 0;
+    burst_muted     = 0;
+#ifdef BURST_PIN
+    /* like the hit sense line */
+    PORTB  |= _BV(BURST_PIN);
+    PCMSK   = _BV(BURST_PIN);
+#endif
+#endif
+#ifdef MUTATE
+    memset(frame_mutation, UNMUTATED, sizeof(frame_mutation));
+    mutate_state    = MUTATE_SEED;
+#endif
+
+#ifdef FAST_BOOT
+    /* send the boot frame from all frames, over & over until the 1st IDs 
+     * replace it in the ones we're not sending */
+    for(uint8_t frame = 0; frame < sizeof(em_bits); frame += FRAME_SIZE) {
+        memcpy_P(&em_bits[frame], boot_frame, FRAME_SIZE);
+        memcpy_P(em_frame_id[frame / FRAME_SIZE], boot_id, 5);
+    }
+    start_sending();
+#endif
 
     /* set startup values */
-    send_offset     = 255;
-    read_offset_id  = 0;
-    send_counter    = MAX_SEND_COUNTER;
+    load_em_ranges();
+    read_range      = profile.first_range;
+    read_offset_id  = read_range * 5;
+    read_count      = 0;
+#if CHECKPOINT_IDS
+    load_checkpoint();
+    /* a checkpoint taken by another profile, out of this one's ranges */
+    if ((uint8_t)(read_range - profile.first_range) >= profile.ranges) {
+        read_range      = profile.first_range;
+        read_offset_id  = read_range * 5;
+    }
+#endif
+#ifdef STATS
+    load_stats();
+#endif
+#ifdef REPLAY_WINNER
+    load_winner();
+#endif
+
+#ifndef FAST_BOOT
+    /* writing the header & footer to em_bits[] only once */
+    for(uint8_t frame = 0; frame < sizeof(em_bits); frame += FRAME_SIZE) {
+        write_header(frame);
+    }
+
+    /* write the 1st ID to all frames, the 1st one of them is queued */
+    clear_id(0);
+    next_em_id(0);
+#if PROTOCOL == PROTOCOL_EM41XX
+    /* there's no frame before the 1st one */
+    set_polarity(0, 0);
+#endif
+    for(uint8_t frame = FRAME_SIZE; frame < sizeof(em_bits);
+        frame += FRAME_SIZE) {
+        copy_em_id(frame, 0);
+    }
+    send_counter    = 1;
 
-    /* writing EM41xx header & footer to em_bits[] only once */
-    write_em_header_footer();
+    start_sending();
+#else
+    /* the boot frame has the header & footer already, the 1st ID goes to the
+     * next frame we fill */
+    send_counter    = profile.repeat;
+#endif
+    UNDERRUNS = 0;
+#if defined(HIT_SENSE) || defined(BURST_PIN)
+    GIFR    = _BV(PCIF);
+#endif
+
+    /* the frame on air, the last one filled, the next one to fill & the 
+     * number of those filled after the one on air */
+    uint8_t send_frame = SEND_FRAME();
+    uint8_t last_frame = send_frame;
+    uint8_t fill_frame = NEXT_FRAME(send_frame);
+    uint8_t queued = 0;
+#ifdef RATE_PROBE
+    uint8_t probe_counter = 0;
+#endif
+#ifdef FAST_BOOT
+    /* the frames still holding the boot frame */
+    uint8_t boot_frames = RING_FRAMES;
+#endif
+#ifdef TRACE
+    /* a record of the 1st ID */
+    memcpy(trace_id, em_frame_id[send_frame / FRAME_SIZE], 5);
+    trace_due       = 1;
+#endif
     
     while (1) {
-        /* are we at the end of em_bits[] ? */
-        if (send_offset >= (sizeof(em_bits) * 2)) {
-
-            /* set offset to zero & send_bit to 1st bit in buffer */
-            send_offset = 0;
-            send_bit = em_bits[send_offset];
+#if CHECKPOINT_IDS
+        write_checkpoint();
+#endif
+#ifdef STATS
+        write_stats();
+#endif
+#ifdef HIT_SENSE
+        /* has the reader accepted one of the last IDs on air? */
+        watch_hit();
+#endif
+#ifdef BURST_PIN
+        /* has the reader locked us out? */
+        watch_lockout();
+#endif
 
-            /* have we sent current ID enough times? */
-            if (++send_counter >= MAX_SEND_COUNTER) {
+        /* how many frames has the interrupt call moved on since? */
+        uint8_t frame = SEND_FRAME();
+        uint8_t started = 0;
+        if (frame != send_frame) {
+            started = (uint8_t)(frame + sizeof(em_bits) - send_frame) 
+                      / FRAME_SIZE % RING_FRAMES;
+#ifdef BURST
+            burst_frame(frame);
+#endif
+#ifdef HIT_SENSE
+            if (hit_state == HIT_SWEEPING && !BURST_MUTED) {
+                log_hit_id(frame);
+            }
+#endif
+#ifdef TRACE
+            trace_frame(frame, started);
+#endif
+#ifdef STATS
+            /* how far into the frame we got to it, a whole one if we missed
+             * some */
+            uint8_t late = started > 1 ? FRAME_SIZE : frame_byte();
+            if (late > stats.latency) {
+                stats.latency = late;
+            }
+            if (!BURST_MUTED) {
+                stats.frames += started;
+            }
+#endif
+        }
+        send_frame = frame;
+        if (started > queued) {
+            /* it got to frames we didn't fill, fill the ones after it */
+            if (UNDERRUNS != 255) {
+                UNDERRUNS++;
+            }
+#ifdef STATS
+            stats.lost += started - queued;
+#endif
+            /* the next one goes on air after it, set_polarity() chains on */
+            last_frame = frame;
+            fill_frame = NEXT_FRAME(frame);
+            queued = 0;
+        } else {
+            queued -= started;
+        }
 
-                /* disable interrupts so nothing is sent atm */
-                cli();
+        /* have we filled all frames but the one on air? */
+        if (queued >= RING_FRAMES - 1) {
+#ifdef TRACE
+            /* idle cycles for the trace first */
+            if (trace_idle()) {
+                continue;
+            }
+#endif
+            /* nothing to do until the next interrupt call wakes us up. the
+             * calls waking us send their edges (Indala's phase flips) 1 to 4
+             * cycles later than the ones finding us busy filling a frame,
+             * which is all the jitter there is, an eighth of a half bit at
+             * RF/64. the USI & HID's FSK time theirs in hardware */
+            sleep_cpu();
+            continue;
+        }
 
-                /* reset counter */
-                send_counter = 0;
-                
-                /* write the current ID in the list */
-                write_em_id();
+#ifdef FAST_BOOT
+        /* the boot frame is manchester, biphase has to write it all over */
+        if (boot_frames) {
+            boot_frames--;
+            if (profile.encoding == ENCODING_BIPHASE) {
+                write_header(fill_frame);
+                clear_id(fill_frame);
+            }
+        }
+#endif
 
-                /* increment the current ID in the list */
-                inc_em_id();
+#ifdef BURST
+        /* pausing? the frame is sent quiet, as it is */
+        if (burst_fill(fill_frame, send_counter >= profile.repeat)) {
+            last_frame = fill_frame;
+            fill_frame = NEXT_FRAME(fill_frame);
+            queued++;
+            continue;
+        }
+#endif
+#ifdef MUTATE
+        /* the frame is written on top of what's there, without its mutation */
+        unmutate(fill_frame);
+#endif
 
-                /* proceed to next ID in em_id_list[] */
-                read_offset_id += 5;
+        /* have we queued current ID enough times? */
+        if (send_counter >= profile.repeat) {
 
-                /* are we at the end of em_id_list[] ? */
-                if (read_offset_id >= sizeof(em_id_list)) {
-                    /* reset to 1st ID in em_id_list[] */
-                    read_offset_id = 0;
-                }
+            /* reset counter */
+            send_counter = 0;
 
-                /* enable interrupts - we're sending again, hooray! */
-                sei();
-            }
+            /* write the next ID, it goes on air right after the current one */
+            next_em_id(fill_frame);
+#if CHECKPOINT_IDS
+            save_checkpoint();
+#endif
+#ifdef STATS
+            stats.ids++;
+            save_stats();
+#endif
+        } else {
+            /* the current ID once more */
+            copy_em_id(fill_frame, last_frame);
+#ifdef MUTATE
+            /* without the mutation of the one copied */
+            frame_mutation[fill_frame / FRAME_SIZE] =
+                frame_mutation[last_frame / FRAME_SIZE];
+            unmutate(fill_frame);
+#endif
+        }
+#if PROTOCOL == PROTOCOL_EM41XX
+        set_polarity(fill_frame, last_frame);
+#endif
+#ifdef MUTATE
+        mutate(fill_frame);
+#endif
+        send_counter++;
+        last_frame = fill_frame;
+        fill_frame = NEXT_FRAME(fill_frame);
+        queued++;
+#if HIT_MODE == HIT_BISECT && defined(HIT_SENSE)
+        count_hit_frame();
+#endif
 
-            /* toggle debug led - we're sending a new ID */
-            PORTB ^= _BV(PINB0);
+#ifdef RATE_PROBE
+        /* switch between RF/64 & RF/32, led is on for DATA_RATE. the frame 
+         * on air while switching is lost, which doesn't matter when probing.
+         * toggled through PINB, a read-modify-write of PORTB could undo the
+         * interrupt call's toggle of DI */
+        if (++probe_counter >= PROBE_FRAMES) {
+            probe_counter = 0;
+            OCR0A ^= (64 / 2 - 1) ^ (32 / 2 - 1);
+            PINB = _BV(PROBE_PIN);
         }
+#elif !defined(OUTPUT_USI) && (!defined(TRACE) || TRACE_PIN != PINB0)
+        /* toggle debug led - we're sending a new frame */
+        PORTB ^= _BV(PINB0);
+#endif
     }
 
     /* we shouldn't be getting here. so long, and thanks for all the fish. */